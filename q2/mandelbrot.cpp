@@ -4,10 +4,14 @@
 using namespace std;
 
 bool checkIfMandelbrot(complex<double> c, int N) {
-    complex<double> z = 0;
+    double zr = 0, zi = 0, zr2 = 0, zi2 = 0;
     for (int i = 0; i < N; i++) { 
-        z = pow(z, 2) + c;
-        if (abs(z) > 2) {
+        // z = z^2 + c on the real/imag parts, tested against |z|^2 > 4 (no pow or sqrt)
+        zi = (zr + zr) * zi + c.imag();
+        zr = zr2 - zi2 + c.real();
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        if (zr2 + zi2 > 4) {
             return false; // Diverges: c is not in the Mandelbrot set
         }
     }
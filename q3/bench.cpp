@@ -0,0 +1,180 @@
+/*
+ * Throughput benchmark for libmandelbrot.so
+ *
+ * Renders a fixed view of the set for every combination of region size,
+ * iteration count, thread count, kernel and shortcut setting, and writes one
+ * CSV row per combination to stdout:
+ *
+ *   kernel,width,height,max_iter,threads,shortcuts,seconds,mpixels_per_s,iterations_per_s
+ *
+ * seconds is the best of --repeat runs. iterations_per_s counts the escape
+ * counts produced (what the plain loop would have iterated), so the interior
+ * shortcuts show up as a higher rate. The "cached" kernel sends the region
+ * through the point-array function with the cache enabled, after one warm-up
+ * pass that fills it, so it measures the cost of a frame of repeated queries.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mandelbrot.hpp"
+
+using namespace std;
+
+struct size2 {
+    int width;
+    int height;
+};
+
+// Splits "a,b,c" and converts each item with parse; exits on a bad item
+template <typename T>
+static vector<T> parse_list(const char* text, bool (*parse)(const string&, T*)){
+    vector<T> items;
+    string s(text);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == string::npos) {
+            comma = s.size();
+        }
+        T item;
+        if (!parse(s.substr(start, comma - start), &item)) {
+            fprintf(stderr, "Invalid list item in '%s'\n", text);
+            exit(1);
+        }
+        items.push_back(item);
+        start = comma + 1;
+    }
+    return items;
+}
+
+static bool parse_int(const string& s, int* v){
+    char* end;
+    long n = strtol(s.c_str(), &end, 10);
+    *v = (int)n;
+    return !s.empty() && *end == '\0' && n >= 0;
+}
+
+static bool parse_size(const string& s, size2* v){
+    return sscanf(s.c_str(), "%dx%d", &v->width, &v->height) == 2 && v->width > 0 && v->height > 0;
+}
+
+static bool parse_name(const string& s, string* v){
+    *v = s;
+    return !s.empty();
+}
+
+static double seconds_since(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]){
+    unsigned hw = max(1u, thread::hardware_concurrency());
+    vector<size2> sizes = parse_list<size2>("320x240,1920x1080", parse_size);
+    vector<int> iters = parse_list<int>("100,1000", parse_int);
+    vector<int> threads = parse_list<int>(("1," + to_string(hw)).c_str(), parse_int);
+    vector<string> kernels = parse_list<string>("scalar,sse2,avx2,avx512,neon,cached", parse_name);
+    vector<int> shortcuts = parse_list<int>("0,3", parse_int);
+    int repeat = 3;
+
+    for (int i = 1; i < argc; i++) {
+        const char* next = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (next == nullptr) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--sizes") == 0) {
+            sizes = parse_list<size2>(next, parse_size);
+        } else if (strcmp(argv[i], "--iters") == 0) {
+            iters = parse_list<int>(next, parse_int);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = parse_list<int>(next, parse_int);
+        } else if (strcmp(argv[i], "--kernels") == 0) {
+            kernels = parse_list<string>(next, parse_name);
+        } else if (strcmp(argv[i], "--shortcuts") == 0) {
+            shortcuts = parse_list<int>(next, parse_int);
+        } else if (strcmp(argv[i], "--repeat") == 0) {
+            repeat = max(1, atoi(next));
+        } else {
+            fprintf(stderr, "Usage: %s [--sizes WxH,...] [--iters N,...] [--threads T,...]"
+                            " [--kernels name,...] [--shortcuts flags,...] [--repeat R]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    // Each thread count once, also when hardware_concurrency() is 1
+    sort(threads.begin(), threads.end());
+    threads.erase(unique(threads.begin(), threads.end()), threads.end());
+
+    printf("kernel,width,height,max_iter,threads,shortcuts,seconds,mpixels_per_s,iterations_per_s\n");
+    const char* default_kernel = mandelbrot_kernel_name();
+
+    for (const string& kernel : kernels) {
+        bool cached = (kernel == "cached");
+        if (!mandelbrot_set_kernel(cached ? default_kernel : kernel.c_str())) {
+            fprintf(stderr, "Skipping kernel %s: not supported on this machine\n", kernel.c_str());
+            continue;
+        }
+        for (const size2& size : sizes) {
+            // The classic full view: x in [-2, 1], y in [-1.2, 1.2]
+            mandelbrot_region region = {-2.0, -1.2, 3.0 / size.width, 2.4 / size.height,
+                                        size.width, size.height, 0};
+            size_t pixels = (size_t)size.width * size.height;
+            vector<int> out(pixels);
+            vector<complex<double>> points;
+            if (cached) {
+                points.reserve(pixels);
+                for (int y = 0; y < size.height; y++) {
+                    for (int x = 0; x < size.width; x++) {
+                        points.push_back(complex<double>(region.re0 + x * region.step_re,
+                                                         region.im0 + y * region.step_im));
+                    }
+                }
+            }
+            for (int max_iter : iters) {
+                region.max_iter = max_iter;
+                for (int flags : shortcuts) {
+                    mandelbrot_set_shortcuts((unsigned)flags);
+                    // The point-array function is single-threaded, so cached runs once
+                    vector<int> thread_counts = cached ? vector<int>(1, 1) : threads;
+                    for (int t : thread_counts) {
+                        mandelbrot_render_options options = {t, 0, 0};
+                        if (cached) {
+                            mandelbrot_cache_configure(pixels, 0);
+                            mandelbrot_escape_counts(points.data(), pixels, max_iter, out.data());
+                        }
+                        double best = 1e300;
+                        for (int r = 0; r < repeat; r++) {
+                            auto start = chrono::steady_clock::now();
+                            if (cached) {
+                                mandelbrot_escape_counts(points.data(), pixels, max_iter, out.data());
+                            } else {
+                                mandelbrot_escape_counts(region, out.data(), options);
+                            }
+                            best = min(best, seconds_since(start));
+                        }
+                        if (cached) {
+                            mandelbrot_cache_configure(0, 0);
+                        }
+
+                        double iterations = 0;
+                        for (int c : out) {
+                            iterations += c;
+                        }
+                        printf("%s,%d,%d,%d,%d,%d,%.6f,%.3f,%.6g\n", kernel.c_str(), size.width,
+                               size.height, max_iter, t, flags, best, pixels / best / 1e6,
+                               iterations / best);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
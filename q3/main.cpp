@@ -1,13 +1,350 @@
 #include <iostream>
 #include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "mandelbrot.hpp"
 
 using namespace std;
-int main() {
+
+// Fast path for decimal numbers like "-0.125" or "3e-2": when the digits fit
+// in 2^53 and the power of ten is at most 10^22 both are exact doubles, so one
+// multiply or divide gives the correctly rounded result (Clinger). Anything
+// else (more digits, inf, nan, hex) goes through strtod. p points at the token,
+// which must be followed by a whitespace or NUL byte; on success *next is set
+// past it.
+static bool parse_double(const char* p, const char** next, double* value){
+    static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char* s = p;
+    bool negative = (*s == '-');
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char* first_digit = s;
+    for (; *s >= '0' && *s <= '9'; s++, digits++) {
+        mantissa = mantissa * 10 + (*s - '0');
+    }
+    if (*s == '.') {
+        s++;
+        for (; *s >= '0' && *s <= '9'; s++, digits++, exponent--) {
+            mantissa = mantissa * 10 + (*s - '0');
+        }
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        bool negative_exp = (*s == '-');
+        if (*s == '-' || *s == '+') {
+            s++;
+        }
+        int e = 0;
+        const char* exp_start = s;
+        for (; *s >= '0' && *s <= '9' && e < 10000; s++) {
+            e = e * 10 + (*s - '0');
+        }
+        if (s == exp_start) {
+            digits = 0; // "1e" and friends: let strtod decide
+        }
+        exponent += negative_exp ? -e : e;
+    }
+    bool token_end = (*s == '\0' || *s == ' ' || *s == '\n' || *s == '\t' || *s == '\r');
+    if (digits > 0 && digits <= 19 && token_end && s != first_digit &&
+        mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double v = (double)mantissa;
+        v = exponent < 0 ? v / pow10[-exponent] : v * pow10[exponent];
+        *value = negative ? -v : v;
+        *next = s;
+        return true;
+    }
+    char* end;
+    *value = strtod(p, &end);
+    *next = end;
+    return end != p;
+}
+
+// --batch: reads "re im" pairs from stdin in large blocks, runs each block
+// through the library in one call and writes all answers to a single output
+// buffer. Stops at end of input, at "0 0" or at anything that isn't a number,
+// like the interactive loop, but without prompts. Each answer repeats the two
+// numbers exactly as they were written instead of reformatting them.
+static int run_batch(int N){
+    const size_t read_size = 1 << 20;
+    const size_t flush_size = 1 << 20;
+    vector<char> in(read_size + 1);
+    size_t have = 0;     // bytes of in[] holding unparsed input
+    bool eof = false;
+    bool done = false;
+    vector<complex<double>> points;
+    vector<const char*> tokens; // start and end of the re and im text of each point
+    vector<int> counts;
+    string out;
+    out.reserve(flush_size + 256);
+
+    while (!done) {
+        if (!eof) {
+            size_t want = read_size - have;
+            size_t got = fread(in.data() + have, 1, want, stdin);
+            have += got;
+            eof = (got < want); // fread only comes up short at end of input (or on error)
+        }
+        in[have] = '\0';
+
+        // Only tokens followed by whitespace are complete; the rest waits for the next read
+        size_t usable = have;
+        if (!eof) {
+            while (usable > 0 && !isspace((unsigned char)in[usable - 1])) {
+                usable--;
+            }
+        }
+        char saved = in[usable];
+        in[usable] = '\0';
+
+        points.clear();
+        tokens.clear();
+        const char* p = in.data();
+        const char* end = in.data() + usable;
+        const char* resume = p; // start of the first pair not fully parsed
+        for (;;) {
+            while (p < end && isspace((unsigned char)*p)) {
+                p++;
+            }
+            resume = p;
+            if (p == end) {
+                break;
+            }
+            double real, imag;
+            const char* q;
+            if (!parse_double(p, &q, &real)) {
+                done = true;
+                break;
+            }
+            const char* real_end = q;
+            while (q < end && isspace((unsigned char)*q)) {
+                q++;
+            }
+            if (q == end) {
+                break; // The imaginary part is still to be read
+            }
+            if (!parse_double(q, &p, &imag)) {
+                done = true;
+                break;
+            }
+            if (real == 0.0 && imag == 0.0) {
+                done = true;
+                break;
+            }
+            points.push_back(complex<double>(real, imag));
+            const char* span[] = {resume, real_end, q, p};
+            tokens.insert(tokens.end(), span, span + 4);
+        }
+        in[usable] = saved;
+
+        counts.resize(points.size());
+        mandelbrot_escape_counts(points.data(), points.size(), N, counts.data());
+        for (size_t i = 0; i < points.size(); i++) {
+            const char* const* span = &tokens[4 * i];
+            out.append(span[0], span[1]);
+            out.append(" + ");
+            out.append(span[2], span[3]);
+            out.append(counts[i] == N ? "i : is in the Mandelbrot set.\n" : "i : is not in the Mandelbrot set.\n");
+            if (out.size() >= flush_size) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+
+        size_t consumed = resume - in.data();
+        if (consumed == 0 && have == read_size) {
+            cerr << "Error: input token longer than the read buffer\n";
+            return 1;
+        }
+        memmove(in.data(), in.data() + consumed, have - consumed);
+        have -= consumed;
+        if (eof && !done) {
+            done = true; // Whatever is left is half a pair
+        }
+    }
+
+    fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
+
+static bool write_all(int fd, const void* data, size_t len){
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// --binary: the input file is a flat array of little-endian (re, im) double
+// pairs. It is mmap'd and handed to the library as it is, with no parsing or
+// copying. The output is written in the same order, either as a bitset (bit i
+// of byte i / 8, LSB first, set when point i is in the set) or, with --u16, as
+// one little-endian uint16 escape count per point (saturated at 65535).
+static int run_binary(const char* input, const char* output, bool u16, int N){
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    (void)input; (void)output; (void)u16; (void)N;
+    cerr << "Error: binary mode needs a little-endian host\n";
+    return 1;
+#else
+    int in_fd = open(input, O_RDONLY);
+    if (in_fd < 0) {
+        perror("open input");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(in_fd, &st) < 0) {
+        perror("fstat input");
+        close(in_fd);
+        return 1;
+    }
+    if (st.st_size % sizeof(complex<double>) != 0) {
+        cerr << "Error: input size is not a multiple of " << sizeof(complex<double>) << " bytes\n";
+        close(in_fd);
+        return 1;
+    }
+    size_t n = st.st_size / sizeof(complex<double>);
+
+    const complex<double>* points = nullptr;
+    if (n > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, in_fd, 0);
+        if (map == MAP_FAILED) {
+            perror("mmap input");
+            close(in_fd);
+            return 1;
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        points = static_cast<const complex<double>*>(map); // std::complex<double> is laid out as re, im
+    }
+    close(in_fd);
+
+    int out_fd = strcmp(output, "-") == 0 ? STDOUT_FILENO : open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        perror("open output");
+        return 1;
+    }
+
+    const size_t chunk = 1 << 16; // a multiple of 8, so chunks never share a bitset byte
+    vector<int> counts(chunk);
+    vector<unsigned char> packed(u16 ? 2 * chunk : chunk / 8);
+    bool ok = true;
+    for (size_t start = 0; start < n && ok; start += chunk) {
+        size_t count = min(chunk, n - start);
+        mandelbrot_escape_counts(points + start, count, N, counts.data());
+        size_t bytes;
+        if (u16) {
+            for (size_t i = 0; i < count; i++) {
+                uint16_t v = (uint16_t)min(counts[i], 65535);
+                memcpy(&packed[2 * i], &v, sizeof v);
+            }
+            bytes = 2 * count;
+        } else {
+            bytes = (count + 7) / 8;
+            memset(packed.data(), 0, bytes);
+            for (size_t i = 0; i < count; i++) {
+                packed[i / 8] |= (unsigned char)((counts[i] == N) << (i % 8));
+            }
+        }
+        ok = write_all(out_fd, packed.data(), bytes);
+    }
+    if (!ok) {
+        perror("write output");
+    }
+
+    if (n > 0) {
+        munmap(const_cast<complex<double>*>(points), st.st_size);
+    }
+    if (out_fd != STDOUT_FILENO && close(out_fd) < 0 && ok) {
+        perror("close output");
+        ok = false;
+    }
+    return ok ? 0 : 1;
+#endif
+}
+
+static void usage(const char* prog){
+    cerr << "Usage: " << prog << " [--cache <entries> [--quantum <step>]]"
+         << " [--batch | --binary <input> <output|-> [--u16]]\n";
+}
+
+// With --cache, the hit/miss counters go to stderr when the program ends
+static void print_cache_stats(){
+    mandelbrot_cache_stats stats = mandelbrot_cache_get_stats();
+    if (stats.capacity == 0) {
+        return;
+    }
+    cerr << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+         << stats.evictions << " evictions, " << stats.size << "/" << stats.capacity << " entries\n";
+}
+
+int main(int argc, char* argv[]) {
 
 
     double real, imag;
      int N = 1000;
+
+    // Options shared by all modes come first
+    int arg = 1;
+    size_t cache_entries = 0;
+    double quantum = 0;
+    for (; arg + 1 < argc; arg += 2) {
+        const char* value = argv[arg + 1];
+        char* end;
+        errno = 0;
+        if (strcmp(argv[arg], "--cache") == 0) {
+            // strtoull would wrap a leading '-' around
+            unsigned long long entries = strtoull(value, &end, 10);
+            if (!isdigit((unsigned char)value[0]) || *end != '\0' || errno != 0 || entries == 0 ||
+                entries > SIZE_MAX) {
+                usage(argv[0]);
+                return 1;
+            }
+            cache_entries = (size_t)entries;
+        } else if (strcmp(argv[arg], "--quantum") == 0) {
+            quantum = strtod(value, &end);
+            if (end == value || *end != '\0' || !isfinite(quantum) || quantum < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            break;
+        }
+    }
+    if (cache_entries > 0) {
+        mandelbrot_cache_configure(cache_entries, quantum);
+    }
+    atexit(print_cache_stats);
+
+    int rest = argc - arg;
+    if (rest == 1 && strcmp(argv[arg], "--batch") == 0) {
+        return run_batch(N);
+    }
+    if ((rest == 3 || rest == 4) && strcmp(argv[arg], "--binary") == 0 &&
+        (rest == 3 || strcmp(argv[arg + 3], "--u16") == 0)) {
+        return run_binary(argv[arg + 1], argv[arg + 2], rest == 4, N);
+    }
+    if (rest != 0) {
+        usage(argv[0]);
+        return 1;
+    }
 	cout << "Enter values for <real> <image>: " << endl;
     while(scanf("%lf %lf" , &real ,&imag) == 2)
     {
@@ -23,9 +360,9 @@ int main() {
         } else {
             cout << real << " + " << imag << "i : is not in the Mandelbrot set.\n";
         }
-	
+
 	cout << "\nEnter another complex number (re im), or 0 0 to quit:\n" ;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,17 +1,271 @@
 #include <iostream>
 #include <string>
 #include <complex>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
 #include "mandelbrot.hpp"
+#include "mandelbrot_cache.hpp"
+#include "mandelbrot_kernel.hpp"
+#include "mandelbrot_tiles.hpp"
 using namespace std;
 
-bool is_in_mandelbrot(complex <double> c, int N){
-    complex<double> z = 0;
-    for (int i = 0; i < N; i++) { 
-        z = pow(z, 2) + c;
-        if (abs(z) > 2) {
-            return false; // Diverges: c is not in the Mandelbrot set
+// Main cardioid and period-2 bulb: the two largest components of the set
+static bool in_cardioid_or_bulb(double cr, double ci){
+    double xq = cr - 0.25;
+    double ci2 = ci * ci;
+    double q = xq * xq + ci2;
+    double xb = cr + 1.0;
+    return q * (q + xq) <= 0.25 * ci2 || xb * xb + ci2 <= 0.0625;
+}
+
+namespace {
+
+// The scalar kernel with the iteration count N fixed at compile time (0: use
+// max_iter). Without periodicity detection a fixed count runs the unrolled
+// mandelbrot_escape_count<N>; with it, the check needs a test after every
+// step, so the loop stays step by step and only its bound is a constant.
+struct scalar_kernel {
+    template <int N>
+    static void run(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out)
+    {
+        const int limit = N != 0 ? N : max_iter;
+        bool periodicity = (shortcuts & MANDELBROT_PERIODICITY_CHECK) != 0;
+        for (int j = 0; j < n; j++) {
+            double cr = re[j], ci = im[j];
+            if ((shortcuts & MANDELBROT_CARDIOID_CHECK) && in_cardioid_or_bulb(cr, ci)) {
+                out[j] = limit;
+                continue;
+            }
+            if (N != 0 && !periodicity) {
+                out[j] = mandelbrot_escape_count<N>(cr, ci);
+                continue;
+            }
+
+            double zr = 0, zi = 0, zr2 = 0, zi2 = 0;
+            double saved_r = 0, saved_i = 0;
+            int next_save = 1;
+            int i = 0;
+            for (; i < limit; i++) {
+                // z = z^2 + c, tested against |z|^2 > 4 to avoid the sqrt in abs()
+                zi = (zr + zr) * zi + ci;
+                zr = zr2 - zi2 + cr;
+                zr2 = zr * zr;
+                zi2 = zi * zi;
+                if (!(zr2 + zi2 <= 4)) {
+                    break; // Diverges: c is not in the Mandelbrot set
+                }
+                if (periodicity) {
+                    // Brent: back at the point saved at the last power of two, so the orbit cycles
+                    double dr = zr - saved_r, di = zi - saved_i;
+                    if (dr * dr + di * di < mandelbrot_period_epsilon2) {
+                        i = limit;
+                        break;
+                    }
+                    if (i == next_save) {
+                        saved_r = zr;
+                        saved_i = zi;
+                        next_save <<= 1;
+                    }
+                }
+            }
+            out[j] = i; // i == limit: c is probably in the Mandelbrot set
         }
     }
-    return true; // Remains bounded: c is probably in the Mandelbrot set
+};
+
+} // namespace
+
+void mandelbrot_kernel_scalar(const double* re, const double* im, int n, int max_iter,
+                              unsigned shortcuts, int* out){
+    mandelbrot_dispatch_fixed<scalar_kernel>(re, im, n, max_iter, shortcuts, out);
+}
+
+namespace {
+
+struct kernel_entry {
+    const char* name;
+    mandelbrot_kernel_fn fn;
+    bool (*supported)();
+};
+
+bool always_supported() { return true; }
+
+#if defined(__x86_64__) || defined(__i386__)
+bool has_avx512() { return __builtin_cpu_supports("avx512f"); }
+bool has_avx2() { return __builtin_cpu_supports("avx2"); }
+bool has_sse2() { return __builtin_cpu_supports("sse2"); }
+#endif
+
+// Fastest first: the first supported entry is the default kernel
+const kernel_entry kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx512", mandelbrot_kernel_avx512, has_avx512},
+    {"avx2", mandelbrot_kernel_avx2, has_avx2},
+    {"sse2", mandelbrot_kernel_sse2, has_sse2},
+#endif
+#if defined(__aarch64__)
+    {"neon", mandelbrot_kernel_neon, always_supported},
+#endif
+    {"scalar", mandelbrot_kernel_scalar, always_supported},
+};
+
+const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+// Starts as scalar so the library is usable even before select_kernel() runs.
+// Each render loads both once (relaxed: they carry no other data), so a switch
+// takes effect from the next call and never mixes kernels within one image.
+atomic<const kernel_entry*> active_kernel(&kernels[kernel_count - 1]);
+
+atomic<unsigned> active_shortcuts(MANDELBROT_CARDIOID_CHECK | MANDELBROT_PERIODICITY_CHECK);
+
+// The kernel and shortcuts one render call uses throughout
+struct render_setup {
+    const kernel_entry* kernel;
+    unsigned shortcuts;
+};
+
+render_setup current_setup(){
+    return {active_kernel.load(memory_order_relaxed), active_shortcuts.load(memory_order_relaxed)};
+}
+
+const kernel_entry* find_kernel(const char* name){
+    for (size_t k = 0; k < kernel_count; k++) {
+        if (strcmp(kernels[k].name, name) == 0) {
+            return kernels[k].supported() ? &kernels[k] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Runs when libmandelbrot.so is loaded. MANDELBROT_KERNEL=<name> overrides the choice.
+__attribute__((constructor)) void select_kernel(){
+    const char* forced = getenv("MANDELBROT_KERNEL");
+    if (forced != nullptr && mandelbrot_set_kernel(forced)) {
+        return;
+    }
+    for (size_t k = 0; k < kernel_count; k++) {
+        if (kernels[k].supported()) {
+            active_kernel.store(&kernels[k], memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+const char* mandelbrot_kernel_name(){
+    return active_kernel.load(memory_order_relaxed)->name;
+}
+
+bool mandelbrot_set_kernel(const char* name){
+    const kernel_entry* kernel = find_kernel(name);
+    if (kernel == nullptr) {
+        return false;
+    }
+    active_kernel.store(kernel, memory_order_relaxed);
+    return true;
+}
+
+// Renders the pixels [x0, x0 + w) x [y0, y0 + h) of the region into out
+static void render_tile(const mandelbrot_region& region, const render_setup& setup, int* out,
+                        int x0, int y0, int w, int h){
+    // The kernel works on arrays of coordinates, so lay each row out in chunks
+    const int chunk = 256;
+    double re[chunk], im[chunk];
+    for (int y = y0; y < y0 + h; y++) {
+        double row_im = region.im0 + y * region.step_im;
+        int* row = out + (size_t)y * region.width;
+        for (int x = x0; x < x0 + w; x += chunk) {
+            int n = min(chunk, x0 + w - x);
+            for (int k = 0; k < n; k++) {
+                re[k] = region.re0 + (x + k) * region.step_re;
+                im[k] = row_im;
+            }
+            setup.kernel->fn(re, im, n, region.max_iter, setup.shortcuts, row + x);
+        }
+    }
+}
+
+void mandelbrot_set_shortcuts(unsigned shortcuts){
+    active_shortcuts.store(shortcuts, memory_order_relaxed);
+}
+
+unsigned mandelbrot_shortcuts(){
+    return active_shortcuts.load(memory_order_relaxed);
+}
+
+void mandelbrot_escape_counts(const mandelbrot_region& region, int* out){
+    render_tile(region, current_setup(), out, 0, 0, region.width, region.height);
+}
+
+void mandelbrot_escape_counts(const mandelbrot_region& region, int* out,
+                              const mandelbrot_render_options& options){
+    render_setup setup = current_setup();
+    mandelbrot_for_each_tile(region.width, region.height, options,
+                             [&](int x0, int y0, int w, int h) { render_tile(region, setup, out, x0, y0, w, h); });
+}
+
+// Counts for one chunk of at most 256 points, answering what it can from the cache
+static void cached_escape_counts(const double* re, const double* im, size_t n, int max_iter,
+                                 const render_setup& setup, int* out){
+    size_t missing[256], source[256];
+    double miss_re[256], miss_im[256];
+    int miss_counts[256];
+    int kernel_index = (int)(setup.kernel - kernels);
+    size_t misses = mandelbrot_cache_lookup(re, im, n, max_iter, setup.shortcuts, kernel_index, out,
+                                            missing, source);
+    if (misses == 0) {
+        return;
+    }
+    for (size_t k = 0; k < misses; k++) {
+        miss_re[k] = re[missing[k]];
+        miss_im[k] = im[missing[k]];
+    }
+    setup.kernel->fn(miss_re, miss_im, (int)misses, max_iter, setup.shortcuts, miss_counts);
+    mandelbrot_cache_insert(miss_re, miss_im, misses, max_iter, setup.shortcuts, kernel_index, miss_counts);
+    for (size_t k = 0; k < n; k++) {
+        if (source[k] < misses) {
+            out[k] = miss_counts[source[k]];
+        }
+    }
+}
+
+void mandelbrot_escape_counts(const complex<double>* points, size_t n, int max_iter, int* out){
+    // Split the (re, im) pairs into the separate arrays the kernel expects
+    const size_t chunk = 256;
+    double re[chunk], im[chunk];
+    bool cached = mandelbrot_cache_enabled();
+    render_setup setup = current_setup();
+    for (size_t start = 0; start < n; start += chunk) {
+        size_t count = min(chunk, n - start);
+        for (size_t k = 0; k < count; k++) {
+            re[k] = points[start + k].real();
+            im[k] = points[start + k].imag();
+        }
+        if (cached) {
+            cached_escape_counts(re, im, count, max_iter, setup, out + start);
+        } else {
+            setup.kernel->fn(re, im, (int)count, max_iter, setup.shortcuts, out + start);
+        }
+    }
+}
+
+bool is_in_mandelbrot(complex <double> c, int N){
+    if (N <= 0) {
+        return true; // No iterations run, so nothing can diverge
+    }
+    if (mandelbrot_cache_enabled()) {
+        int count;
+        mandelbrot_escape_counts(&c, 1, N, &count);
+        return count == N;
+    }
+    // A single point is a 1x1 region
+    mandelbrot_region region = {c.real(), c.imag(), 0.0, 0.0, 1, 1, N};
+    int count;
+    mandelbrot_escape_counts(region, &count);
+    return count == N;
 }
 
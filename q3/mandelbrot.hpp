@@ -2,7 +2,151 @@
 #define MANDELBROT_HPP
 
 #include <complex>
+#include <cstddef>
+
+// A width x height grid of points: pixel (x, y) is the complex number
+// (re0 + x * step_re) + (im0 + y * step_im)i
+struct mandelbrot_region {
+    double re0;
+    double im0;
+    double step_re;
+    double step_im;
+    int width;
+    int height;
+    int max_iter;
+};
+
+// Fills out[y * width + x] with the escape count of every pixel in the region:
+// the number of iterations the point survived before |z| > 2, or max_iter if it
+// never diverged. The caller owns out, which must hold width * height ints.
+void mandelbrot_escape_counts(const mandelbrot_region& region, int* out);
+
+// How the threaded mandelbrot_escape_counts() splits a region
+struct mandelbrot_render_options {
+    int threads;     // worker threads, the caller's included (0: one per hardware thread)
+    int tile_width;  // tile size in pixels (0: 64)
+    int tile_height; // (0: 16)
+};
+
+// Same as above, but renders the region tile by tile on a pool of threads that
+// steal tiles from each other, so uneven rows near the set boundary balance out
+void mandelbrot_escape_counts(const mandelbrot_region& region, int* out,
+                              const mandelbrot_render_options& options);
+
+// Escape counts of n arbitrary points (e.g. a block of queries read from a
+// file), one per out[i], using the same kernel as the region functions
+void mandelbrot_escape_counts(const std::complex<double>* points, size_t n, int max_iter, int* out);
+
+// A frame too deep for std::complex<double> (pixel spacing below ~1e-13).
+// The center is decimal text with as many digits as the zoom needs, e.g.
+// "-0.743643887037158704752191506114774", and so is the spacing (e.g.
+// "1e-400"), which may go down to the smallest normal long double;
+// pixel (x, y) is the point
+// center + ((x - (width - 1) / 2) + (y - (height - 1) / 2)i) * step
+struct mandelbrot_deep_region {
+    const char* center_re;
+    const char* center_im;
+    const char* step;
+    int width;
+    int height;
+    int max_iter;
+};
+
+struct mandelbrot_deep_stats {
+    int reference_iterations; // length of the high-precision center orbit
+    long long rebases;        // pixels moved back to the start of the orbit after a glitch
+    bool extended_precision;  // per-pixel differences were kept in long double
+};
+
+// Perturbation rendering: one fixed-point reference orbit for the frame
+// center, then per-pixel differences from it in double (long double once the
+// spacing passes 1e-290), rebasing pixels whose difference loses precision.
+// Fills out like mandelbrot_escape_counts(), on the tile scheduler. stats may
+// be null. Returns false if the step is not a positive number within the long
+// double range, or a center coordinate is invalid.
+bool mandelbrot_deep_escape_counts(const mandelbrot_deep_region& region, int* out,
+                                   const mandelbrot_render_options& options,
+                                   mandelbrot_deep_stats* stats);
+
+// Optional bounded cache for repeated queries through the point-array
+// function and is_in_mandelbrot(). Entries are keyed by (re, im, max_iter),
+// the shortcut flags and the kernel that computed them, with re and im
+// rounded to a multiple of quantum (0: exact coordinates), and evicted
+// CLOCK-style once capacity entries are in use. capacity 0 (the default)
+// disables the cache. Reconfiguring empties the cache and its counters.
+void mandelbrot_cache_configure(size_t capacity, double quantum);
+
+struct mandelbrot_cache_stats {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    size_t size;
+    size_t capacity;
+};
+mandelbrot_cache_stats mandelbrot_cache_get_stats();
 
 bool is_in_mandelbrot(std::complex<double> c, int N);
 
-#endif
\ No newline at end of file
+// Compile-time iteration count. The loop runs in unrolled blocks of
+// mandelbrot_unroll steps with a single escape test per block; a block that
+// escaped is replayed step by step from its saved start to find the exact
+// count, so the result always equals the runtime loop's (without shortcuts).
+// Once |z| > 2 the orbit only grows, so no escape inside a block is missed.
+const int mandelbrot_unroll = 8;
+
+template <int N>
+inline int mandelbrot_escape_count(double cr, double ci)
+{
+    double zr = 0, zi = 0, zr2 = 0, zi2 = 0;
+    int i = 0;
+    for (; i + mandelbrot_unroll <= N; i += mandelbrot_unroll) {
+        double sr = zr, si = zi, sr2 = zr2, si2 = zi2;
+        for (int u = 0; u < mandelbrot_unroll; u++) {
+            zi = (zr + zr) * zi + ci;
+            zr = zr2 - zi2 + cr;
+            zr2 = zr * zr;
+            zi2 = zi * zi;
+        }
+        if (!(zr2 + zi2 <= 4)) { // also catches an orbit that overflowed to nan
+            zr = sr, zi = si, zr2 = sr2, zi2 = si2;
+            break;
+        }
+    }
+    for (; i < N; i++) {
+        zi = (zr + zr) * zi + ci;
+        zr = zr2 - zi2 + cr;
+        zr2 = zr * zr;
+        zi2 = zi * zi;
+        if (!(zr2 + zi2 <= 4)) {
+            return i;
+        }
+    }
+    return N;
+}
+
+template <int N>
+inline bool is_in_mandelbrot(std::complex<double> c)
+{
+    return mandelbrot_escape_count<N>(c.real(), c.imag()) == N;
+}
+
+// The escape-time kernel is picked when the library is loaded: the widest of
+// avx512, avx2, sse2 or neon the CPU supports, else scalar. Setting the
+// MANDELBROT_KERNEL environment variable to one of those names overrides it.
+const char* mandelbrot_kernel_name();
+
+// Switches kernel at runtime (e.g. for benchmarking). Returns false, keeping
+// the current kernel, if the name is unknown or the CPU lacks support for it.
+// Safe to call while rendering; calls already running finish on the old kernel.
+bool mandelbrot_set_kernel(const char* name);
+
+// Shortcuts that let points inside the set stop before max_iter iterations.
+// Both are on by default; mandelbrot_set_shortcuts(0) gives the plain exact loop.
+enum {
+    MANDELBROT_CARDIOID_CHECK = 1,   // analytic main cardioid / period-2 bulb test
+    MANDELBROT_PERIODICITY_CHECK = 2 // Brent-style detection of a cycling orbit
+};
+void mandelbrot_set_shortcuts(unsigned shortcuts);
+unsigned mandelbrot_shortcuts();
+
+#endif
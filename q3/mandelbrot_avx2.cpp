@@ -0,0 +1,13 @@
+#include "mandelbrot_simd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifndef __AVX2__
+#error "mandelbrot_avx2.cpp must be compiled with -mavx2"
+#endif
+
+void mandelbrot_kernel_avx2(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out){
+    simd_escape_counts<4>(re, im, n, max_iter, shortcuts, out);
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "mandelbrot.hpp"
+#include "mandelbrot_cache.hpp"
+using namespace std;
+
+// A fixed number of slots with CLOCK eviction: a hit sets the slot's
+// referenced bit, and the hand looking for a victim clears referenced bits
+// until it finds a slot that has not been hit since its last pass.
+
+namespace {
+
+struct cache_key {
+    int64_t re;
+    int64_t im;
+    int max_iter;
+    unsigned shortcuts;
+    int kernel;
+
+    bool operator==(const cache_key& other) const {
+        return re == other.re && im == other.im && max_iter == other.max_iter &&
+               shortcuts == other.shortcuts && kernel == other.kernel;
+    }
+};
+
+struct cache_key_hash {
+    size_t operator()(const cache_key& k) const {
+        uint64_t h = (uint64_t)k.re * 0x9e3779b97f4a7c15ULL;
+        h ^= (uint64_t)k.im + 0x632be59bd9b4e5f5ULL + (h << 6) + (h >> 2);
+        h ^= (uint64_t)k.max_iter * 0xff51afd7ed558ccdULL;
+        h ^= ((uint64_t)k.shortcuts << 8 | (uint64_t)(unsigned)k.kernel) * 0xc4ceb9fe1a85ec53ULL;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+struct cache_slot {
+    cache_key key;
+    int count;
+    bool referenced;
+};
+
+mutex cache_lock;
+atomic<size_t> cache_capacity(0);
+double cache_quantum = 0;
+vector<cache_slot> slots;
+unordered_map<cache_key, size_t, cache_key_hash> slot_of;
+// Keys missed by the current lookup, to their position in its missing[]
+unordered_map<cache_key, size_t, cache_key_hash> chunk_misses;
+size_t hand = 0;
+mandelbrot_cache_stats stats = {0, 0, 0, 0, 0};
+
+// Rounds to the quantum grid, or uses the exact bits when the quantum is 0.
+// Fails for coordinates the grid cannot represent (inf, nan, far out of range).
+bool quantize(double v, int64_t* q){
+    if (cache_quantum == 0) {
+        memcpy(q, &v, sizeof v);
+        return true;
+    }
+    double scaled = nearbyint(v / cache_quantum);
+    if (!(fabs(scaled) < 9.0e18)) {
+        return false;
+    }
+    *q = (int64_t)scaled;
+    return true;
+}
+
+bool make_key(double re, double im, int max_iter, unsigned shortcuts, int kernel, cache_key* key){
+    key->max_iter = max_iter;
+    key->shortcuts = shortcuts;
+    key->kernel = kernel;
+    return quantize(re, &key->re) && quantize(im, &key->im);
+}
+
+void insert_one(const cache_key& key, int count){
+    auto found = slot_of.find(key);
+    if (found != slot_of.end()) {
+        slots[found->second].count = count;
+        return;
+    }
+    size_t slot;
+    if (slots.size() < cache_capacity) {
+        slot = slots.size();
+        slots.push_back(cache_slot());
+    } else {
+        while (slots[hand].referenced) {
+            slots[hand].referenced = false;
+            hand = (hand + 1) % slots.size();
+        }
+        slot = hand;
+        hand = (hand + 1) % slots.size();
+        slot_of.erase(slots[slot].key);
+        stats.evictions++;
+    }
+    slots[slot].key = key;
+    slots[slot].count = count;
+    slots[slot].referenced = false;
+    slot_of[key] = slot;
+}
+
+} // namespace
+
+void mandelbrot_cache_configure(size_t capacity, double quantum){
+    lock_guard<mutex> guard(cache_lock);
+    slots.clear();
+    slots.shrink_to_fit();
+    slot_of.clear();
+    slot_of.reserve(capacity);
+    hand = 0;
+    cache_quantum = quantum > 0 ? quantum : 0;
+    cache_capacity = capacity;
+    stats = mandelbrot_cache_stats{0, 0, 0, 0, capacity};
+}
+
+mandelbrot_cache_stats mandelbrot_cache_get_stats(){
+    lock_guard<mutex> guard(cache_lock);
+    mandelbrot_cache_stats s = stats;
+    s.size = slots.size();
+    return s;
+}
+
+bool mandelbrot_cache_enabled(){
+    return cache_capacity != 0;
+}
+
+size_t mandelbrot_cache_lookup(const double* re, const double* im, size_t n, int max_iter,
+                               unsigned shortcuts, int kernel, int* out, size_t* missing,
+                               size_t* source){
+    lock_guard<mutex> guard(cache_lock);
+    size_t misses = 0;
+    chunk_misses.clear();
+    for (size_t i = 0; i < n; i++) {
+        cache_key key;
+        if (!make_key(re[i], im[i], max_iter, shortcuts, kernel, &key)) {
+            source[i] = misses;
+            missing[misses++] = i;
+            continue;
+        }
+        auto found = slot_of.find(key);
+        if (found == slot_of.end()) {
+            // Computed once per chunk, however often it repeats in it
+            auto first = chunk_misses.insert(make_pair(key, misses));
+            source[i] = first.first->second;
+            if (first.second) {
+                missing[misses++] = i;
+            }
+            continue;
+        }
+        cache_slot& slot = slots[found->second];
+        slot.referenced = true;
+        out[i] = slot.count;
+        source[i] = n;
+    }
+    stats.hits += n - misses;
+    stats.misses += misses;
+    return misses;
+}
+
+void mandelbrot_cache_insert(const double* re, const double* im, size_t n, int max_iter,
+                             unsigned shortcuts, int kernel, const int* counts){
+    lock_guard<mutex> guard(cache_lock);
+    if (cache_capacity == 0) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        cache_key key;
+        if (make_key(re[i], im[i], max_iter, shortcuts, kernel, &key)) {
+            insert_one(key, counts[i]);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef MANDELBROT_CACHE_HPP
+#define MANDELBROT_CACHE_HPP
+
+// Internal to libmandelbrot.so: the escape-count cache behind
+// mandelbrot_cache_configure().
+
+#include <cstddef>
+
+bool mandelbrot_cache_enabled();
+
+// Counts are cached per max_iter, shortcut flags and kernel (its index in the
+// kernel table), since each of them can change a count.
+
+// Fills out[i] for every point found in the cache and stores the indices of
+// the others in missing[], each key once: source[i] is the position in
+// missing[] of the point whose count point i takes, or n if out[i] was filled.
+// Repeats of a missing key count as hits. Returns how many are missing.
+size_t mandelbrot_cache_lookup(const double* re, const double* im, size_t n, int max_iter,
+                               unsigned shortcuts, int kernel, int* out, size_t* missing,
+                               size_t* source);
+
+void mandelbrot_cache_insert(const double* re, const double* im, size_t n, int max_iter,
+                             unsigned shortcuts, int kernel, const int* counts);
+
+#endif
@@ -0,0 +1,330 @@
+#include <atomic>
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "mandelbrot.hpp"
+#include "mandelbrot_tiles.hpp"
+using namespace std;
+
+// Perturbation rendering for zooms too deep for doubles.
+//
+// Only the orbit of the frame center C is computed exactly, in fixed point
+// with as many bits as the zoom needs. A pixel c = C + dc then follows
+// z_n = Z_n + d_n, where the small difference d_n obeys
+//     d_{n+1} = 2 Z_n d_n + d_n^2 + dc
+// and is tracked in plain double (long double past the double exponent range,
+// down to the smallest normal long double spacing).
+// When |z_n| drops below |d_n| the difference has lost its precision (a
+// "glitch"), so the pixel is rebased onto the start of the reference orbit
+// with d = z_n, which also covers pixels outliving an escaping reference.
+
+namespace {
+
+// Fixed-point number: limb[0] is the integer part, limb[k] the k-th 32-bit
+// fraction digit. Values in the orbit stay far below 2^32.
+class bigfix {
+public:
+    explicit bigfix(size_t limbs) : negative(false), limb(limbs, 0) {}
+
+    static bool parse(const char* text, size_t limbs, bigfix& out);
+
+    double to_double() const {
+        double v = 0;
+        for (size_t k = limb.size(); k-- > 0;) {
+            v += ldexp((double)limb[k], -32 * (int)k);
+        }
+        return negative ? -v : v;
+    }
+
+    friend bigfix operator+(const bigfix& a, const bigfix& b) {
+        if (a.negative == b.negative) {
+            bigfix r = a;
+            add_magnitude(r, b);
+            return r;
+        }
+        if (compare_magnitude(a, b) >= 0) {
+            bigfix r = a;
+            sub_magnitude(r, b);
+            return r;
+        }
+        bigfix r = b;
+        sub_magnitude(r, a);
+        return r;
+    }
+
+    friend bigfix operator-(const bigfix& a, bigfix b) {
+        b.negative = !b.negative;
+        return a + b;
+    }
+
+    friend bigfix operator*(const bigfix& a, const bigfix& b) {
+        // Schoolbook product; limb i times limb j lands at weight 2^-32(i + j),
+        // and everything past the last fraction limb is truncated
+        size_t n = a.limb.size();
+        vector<uint64_t> acc(2 * n, 0);
+        for (size_t i = 0; i < n; i++) {
+            if (a.limb[i] == 0) {
+                continue;
+            }
+            for (size_t j = 0; j < n && i + j < n + 1; j++) {
+                uint64_t p = (uint64_t)a.limb[i] * b.limb[j];
+                acc[i + j] += p & 0xffffffffu;
+                if (i + j > 0) {
+                    acc[i + j - 1] += p >> 32;
+                }
+            }
+        }
+        for (size_t k = 2 * n - 1; k > 0; k--) {
+            acc[k - 1] += acc[k] >> 32;
+            acc[k] &= 0xffffffffu;
+        }
+        bigfix r(n);
+        for (size_t k = 0; k < n; k++) {
+            r.limb[k] = (uint32_t)acc[k];
+        }
+        r.negative = (a.negative != b.negative) && !r.is_zero();
+        return r;
+    }
+
+private:
+    bool negative;
+    vector<uint32_t> limb;
+
+    bool is_zero() const {
+        for (uint32_t l : limb) {
+            if (l != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static int compare_magnitude(const bigfix& a, const bigfix& b) {
+        for (size_t k = 0; k < a.limb.size(); k++) {
+            if (a.limb[k] != b.limb[k]) {
+                return a.limb[k] < b.limb[k] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    static void add_magnitude(bigfix& a, const bigfix& b) {
+        uint64_t carry = 0;
+        for (size_t k = a.limb.size(); k-- > 0;) {
+            uint64_t t = (uint64_t)a.limb[k] + b.limb[k] + carry;
+            a.limb[k] = (uint32_t)t;
+            carry = t >> 32;
+        }
+    }
+
+    // |a| -= |b|, requires |a| >= |b|
+    static void sub_magnitude(bigfix& a, const bigfix& b) {
+        int64_t borrow = 0;
+        for (size_t k = a.limb.size(); k-- > 0;) {
+            int64_t t = (int64_t)a.limb[k] - b.limb[k] - borrow;
+            borrow = t < 0;
+            a.limb[k] = (uint32_t)(t + (borrow << 32));
+        }
+        if (a.is_zero()) {
+            a.negative = false;
+        }
+    }
+
+    void mul_small(uint32_t m) {
+        uint64_t carry = 0;
+        for (size_t k = limb.size(); k-- > 0;) {
+            uint64_t t = (uint64_t)limb[k] * m + carry;
+            limb[k] = (uint32_t)t;
+            carry = t >> 32;
+        }
+    }
+
+    void div_small(uint32_t d) {
+        uint64_t rem = 0;
+        for (size_t k = 0; k < limb.size(); k++) {
+            uint64_t t = (rem << 32) | limb[k];
+            limb[k] = (uint32_t)(t / d);
+            rem = t % d;
+        }
+    }
+};
+
+// Decimal text such as "-0.7436438870371587047521915" or "1.25e-3"
+bool bigfix::parse(const char* text, size_t limbs, bigfix& out) {
+    const char* s = text;
+    bool negative = (*s == '-');
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+    const char* int_begin = s;
+    while (*s >= '0' && *s <= '9') {
+        s++;
+    }
+    const char* int_end = s;
+    const char* frac_begin = s;
+    const char* frac_end = s;
+    if (*s == '.') {
+        frac_begin = ++s;
+        while (*s >= '0' && *s <= '9') {
+            s++;
+        }
+        frac_end = s;
+    }
+    if (int_begin == int_end && frac_begin == frac_end) {
+        return false;
+    }
+    long exponent = 0;
+    if (*s == 'e' || *s == 'E') {
+        char* end;
+        exponent = strtol(s + 1, &end, 10);
+        if (end == s + 1) {
+            return false;
+        }
+        s = end;
+    }
+    if (*s != '\0' || exponent > 9 || exponent < -100000) {
+        return false;
+    }
+
+    bigfix r(limbs);
+    // Fraction digits from the last one up: f = (f + digit) / 10
+    for (const char* d = frac_end; d-- > frac_begin;) {
+        r.limb[0] += *d - '0';
+        r.div_small(10);
+    }
+    uint64_t int_part = 0;
+    for (const char* d = int_begin; d < int_end; d++) {
+        int_part = int_part * 10 + (*d - '0');
+        if (int_part > 0xffffffffu) {
+            return false;
+        }
+    }
+    r.limb[0] = (uint32_t)int_part;
+    for (; exponent > 0; exponent--) {
+        r.mul_small(10);
+    }
+    for (; exponent < 0; exponent++) {
+        r.div_small(10);
+    }
+    r.negative = negative && !r.is_zero();
+    out = r;
+    return true;
+}
+
+// Orbit of the frame center, rounded to double for the per-pixel loops.
+// Ends at max_iter or just after the first point with |Z| > 2.
+struct reference_orbit {
+    vector<double> re, im;
+};
+
+reference_orbit compute_reference(const bigfix& cr, const bigfix& ci, size_t limbs, int max_iter) {
+    reference_orbit orbit;
+    bigfix zr(limbs), zi(limbs);
+    orbit.re.push_back(0);
+    orbit.im.push_back(0);
+    for (int n = 0; n < max_iter; n++) {
+        bigfix zr2 = zr * zr;
+        bigfix zi2 = zi * zi;
+        bigfix t = zr * zi;
+        zi = t + t + ci;
+        zr = zr2 - zi2 + cr;
+        double r = zr.to_double(), i = zi.to_double();
+        orbit.re.push_back(r);
+        orbit.im.push_back(i);
+        if (r * r + i * i > 4) {
+            break;
+        }
+    }
+    return orbit;
+}
+
+// Renders pixels [x0, x0 + w) x [y0, y0 + h) with the differences kept in T.
+// Returns how many rebases the tile needed.
+template <typename T>
+long long render_tile(const mandelbrot_deep_region& region, T step, const reference_orbit& orbit,
+                      int* out, int x0, int y0, int w, int h) {
+    const double* Zr = orbit.re.data();
+    const double* Zi = orbit.im.data();
+    const size_t last = orbit.re.size() - 1;
+    const T half_w = (T)(region.width - 1) / 2, half_h = (T)(region.height - 1) / 2;
+    long long rebases = 0;
+
+    for (int y = y0; y < y0 + h; y++) {
+        for (int x = x0; x < x0 + w; x++) {
+            T dcr = ((T)x - half_w) * step;
+            T dci = ((T)y - half_h) * step;
+            T dr = 0, di = 0;
+            size_t m = 0; // index into the reference orbit
+            int i = 0;
+            for (; i < region.max_iter; i++) {
+                // d' = (2Z + d) d + dc
+                T tr = 2 * (T)Zr[m] + dr, ti = 2 * (T)Zi[m] + di;
+                T nr = tr * dr - ti * di + dcr;
+                di = tr * di + ti * dr + dci;
+                dr = nr;
+                m++;
+
+                T zr = (T)Zr[m] + dr, zi = (T)Zi[m] + di;
+                T mag2 = zr * zr + zi * zi;
+                if (mag2 > 4) {
+                    break; // Diverges: same convention as the double kernels
+                }
+                if (mag2 < dr * dr + di * di || m == last) {
+                    // Glitch, or ran off the end of the reference: restart it from z
+                    dr = zr;
+                    di = zi;
+                    m = 0;
+                    rebases++;
+                }
+            }
+            out[(size_t)y * region.width + x] = i;
+        }
+    }
+    return rebases;
+}
+
+} // namespace
+
+bool mandelbrot_deep_escape_counts(const mandelbrot_deep_region& region, int* out,
+                                   const mandelbrot_render_options& options,
+                                   mandelbrot_deep_stats* stats){
+    if (region.step == nullptr || region.width <= 0 || region.height <= 0) {
+        return false;
+    }
+    // Rejects inf, nan, text after the number and spacings out of range
+    char* end;
+    errno = 0;
+    long double step = strtold(region.step, &end);
+    if (end == region.step || *end != '\0' || errno != 0 || !isfinite(step) || step < LDBL_MIN) {
+        return false;
+    }
+
+    // Enough fraction bits to resolve one pixel, plus 64 to spare
+    int frac_bits = max(0, (int)ceil(-log2l(step))) + 64;
+    size_t limbs = 1 + (frac_bits + 31) / 32;
+    bigfix cr(limbs), ci(limbs);
+    if (!bigfix::parse(region.center_re, limbs, cr) || !bigfix::parse(region.center_im, limbs, ci)) {
+        return false;
+    }
+    reference_orbit orbit = compute_reference(cr, ci, limbs, region.max_iter);
+
+    // Differences of a pixel near 1e-300 underflow in double; long double goes further
+    bool extended = step < 1e-290L;
+    atomic<long long> rebases(0);
+    mandelbrot_for_each_tile(region.width, region.height, options, [&](int x0, int y0, int w, int h) {
+        rebases += extended ? render_tile<long double>(region, step, orbit, out, x0, y0, w, h)
+                            : render_tile<double>(region, (double)step, orbit, out, x0, y0, w, h);
+    });
+
+    if (stats != nullptr) {
+        stats->reference_iterations = (int)orbit.re.size() - 1;
+        stats->rebases = rebases;
+        stats->extended_precision = extended;
+    }
+    return true;
+}
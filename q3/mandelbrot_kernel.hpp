@@ -0,0 +1,53 @@
+#ifndef MANDELBROT_KERNEL_HPP
+#define MANDELBROT_KERNEL_HPP
+
+#include "mandelbrot.hpp"
+
+// Internal to libmandelbrot.so: the escape-time kernels behind the public API.
+//
+// A kernel fills out[i] with the escape count of the point re[i] + im[i]i for
+// every i < n, with the same meaning as mandelbrot_escape_counts().
+// shortcuts is a set of MANDELBROT_*_CHECK flags from mandelbrot.hpp.
+
+typedef void (*mandelbrot_kernel_fn)(const double* re, const double* im, int n,
+                                     int max_iter, unsigned shortcuts, int* out);
+
+// Squared distance under which an orbit is taken to have returned to a saved point
+const double mandelbrot_period_epsilon2 = 1e-24;
+
+// Runs K::run<N>() when max_iter is one of the iteration counts common
+// enough to get their own instantiation, and K::run<0>() (count only known at
+// runtime) otherwise. Every kernel goes through it, so a compile-time bound
+// is used whatever the kernel and shortcut setting.
+template <typename K>
+inline void mandelbrot_dispatch_fixed(const double* re, const double* im, int n, int max_iter,
+                                      unsigned shortcuts, int* out)
+{
+    switch (max_iter) {
+    case 50: K::template run<50>(re, im, n, max_iter, shortcuts, out); break;
+    case 100: K::template run<100>(re, im, n, max_iter, shortcuts, out); break;
+    case 200: K::template run<200>(re, im, n, max_iter, shortcuts, out); break;
+    case 256: K::template run<256>(re, im, n, max_iter, shortcuts, out); break;
+    case 500: K::template run<500>(re, im, n, max_iter, shortcuts, out); break;
+    case 1000: K::template run<1000>(re, im, n, max_iter, shortcuts, out); break;
+    case 2000: K::template run<2000>(re, im, n, max_iter, shortcuts, out); break;
+    case 5000: K::template run<5000>(re, im, n, max_iter, shortcuts, out); break;
+    case 10000: K::template run<10000>(re, im, n, max_iter, shortcuts, out); break;
+    default: K::template run<0>(re, im, n, max_iter, shortcuts, out); break;
+    }
+}
+
+// One point at a time. Always available, and used for the tail of every SIMD kernel
+void mandelbrot_kernel_scalar(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out);
+
+#if defined(__x86_64__) || defined(__i386__)
+void mandelbrot_kernel_sse2(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out);
+void mandelbrot_kernel_avx2(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out);
+void mandelbrot_kernel_avx512(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out);
+#endif
+
+#if defined(__aarch64__)
+void mandelbrot_kernel_neon(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out);
+#endif
+
+#endif
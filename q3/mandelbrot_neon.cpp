@@ -0,0 +1,10 @@
+#include "mandelbrot_simd.hpp"
+
+#if defined(__aarch64__)
+
+// NEON is part of the AArch64 baseline, so no extra flags are needed
+void mandelbrot_kernel_neon(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out){
+    simd_escape_counts<2>(re, im, n, max_iter, shortcuts, out);
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef MANDELBROT_SIMD_HPP
+#define MANDELBROT_SIMD_HPP
+
+// Generic W-lane escape-time kernel written with GCC vector extensions.
+// Each mandelbrot_<isa>.cpp includes this file and is compiled with its own
+// -m flags, so the same loop becomes SSE2, AVX2, AVX-512 or NEON code.
+// Everything here has internal linkage: the per-ISA copies must never be
+// merged by the linker.
+
+#include <cstring>
+#include "mandelbrot_kernel.hpp"
+
+namespace {
+
+template <int W>
+struct simd_lanes {
+    typedef double real __attribute__((vector_size(W * sizeof(double))));
+    typedef long long mask __attribute__((vector_size(W * sizeof(long long))));
+};
+
+template <int W>
+inline bool any_lane(typename simd_lanes<W>::mask m)
+{
+    long long bits = 0;
+    for (int l = 0; l < W; l++) {
+        bits |= m[l];
+    }
+    return bits != 0;
+}
+
+// W lanes at a time, with the iteration count N fixed at compile time (0: use max_iter)
+template <int W, int N>
+inline void simd_escape_counts_fixed(const double* re, const double* im, int n, int max_iter,
+                                     unsigned shortcuts, int* out)
+{
+    const int limit = N != 0 ? N : max_iter;
+    typedef typename simd_lanes<W>::real real;
+    typedef typename simd_lanes<W>::mask mask;
+
+    int i = 0;
+    for (; i + W <= n; i += W) {
+        real cr, ci;
+        std::memcpy(&cr, re + i, sizeof cr);
+        std::memcpy(&ci, im + i, sizeof ci);
+
+        real zr = {}, zi = {}, zr2 = {}, zi2 = {};
+        mask count = {};
+        mask active = count == count; // all lanes set
+        mask interior = {};           // lanes known to be in the set without iterating to max_iter
+
+        if (shortcuts & MANDELBROT_CARDIOID_CHECK) {
+            real xq = cr - 0.25;
+            real ci2 = ci * ci;
+            real q = xq * xq + ci2;
+            real xb = cr + 1.0;
+            interior = (q * (q + xq) <= 0.25 * ci2) | (xb * xb + ci2 <= 0.0625);
+            active &= ~interior;
+        }
+
+        bool periodicity = (shortcuts & MANDELBROT_PERIODICITY_CHECK) != 0;
+        real saved_r = {}, saved_i = {};
+        int next_save = 1;
+
+        int iterations = any_lane<W>(active) ? limit : 0; // nothing to do if every lane is interior
+        for (int k = 0; k < iterations; k++) {
+            // z = z^2 + c with plain real/imag arithmetic
+            zi = (zr + zr) * zi + ci;
+            zr = zr2 - zi2 + cr;
+            zr2 = zr * zr;
+            zi2 = zi * zi;
+
+            // |z| > 2 without the sqrt; an escaped lane stays cleared and stops counting
+            active &= (zr2 + zi2 <= 4.0);
+            count -= active;
+
+            if (periodicity) {
+                // Brent: an orbit that comes back to the point saved at the last
+                // power of two is cycling and will never escape
+                real dr = zr - saved_r, di = zi - saved_i;
+                mask cycle = active & (dr * dr + di * di < mandelbrot_period_epsilon2);
+                interior |= cycle;
+                active &= ~cycle;
+                if (k == next_save) {
+                    saved_r = zr;
+                    saved_i = zi;
+                    next_save <<= 1;
+                }
+            }
+
+            // Escaped lanes keep iterating harmlessly, so check the mask only every 4 steps
+            if ((k & 3) == 3 && !any_lane<W>(active)) {
+                break;
+            }
+        }
+
+        for (int l = 0; l < W; l++) {
+            out[i + l] = interior[l] ? limit : (int)count[l];
+        }
+    }
+
+    if (i < n) {
+        mandelbrot_kernel_scalar(re + i, im + i, n - i, max_iter, shortcuts, out + i);
+    }
+}
+
+template <int W>
+struct simd_kernel {
+    template <int N>
+    static void run(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out)
+    {
+        simd_escape_counts_fixed<W, N>(re, im, n, max_iter, shortcuts, out);
+    }
+};
+
+template <int W>
+inline void simd_escape_counts(const double* re, const double* im, int n, int max_iter,
+                               unsigned shortcuts, int* out)
+{
+    mandelbrot_dispatch_fixed<simd_kernel<W> >(re, im, n, max_iter, shortcuts, out);
+}
+
+} // namespace
+
+#endif
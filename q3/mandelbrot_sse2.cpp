@@ -0,0 +1,13 @@
+#include "mandelbrot_simd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifndef __SSE2__
+#error "mandelbrot_sse2.cpp must be compiled with -msse2"
+#endif
+
+void mandelbrot_kernel_sse2(const double* re, const double* im, int n, int max_iter, unsigned shortcuts, int* out){
+    simd_escape_counts<2>(re, im, n, max_iter, shortcuts, out);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mandelbrot_tiles.hpp"
+using namespace std;
+
+namespace {
+
+const int default_tile_width = 64;
+const int default_tile_height = 16;
+
+// The tiles [begin, end) a thread still has to render. The owner takes from
+// the front and thieves take from the back, both under the lock.
+struct alignas(64) tile_queue {
+    mutex lock;
+    int begin = 0;
+    int end = 0;
+};
+
+bool pop_front(tile_queue& queue, int& tile){
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.begin == queue.end) {
+        return false;
+    }
+    tile = queue.begin++;
+    return true;
+}
+
+// Moves the back half of some other queue into self (which is empty)
+bool steal(vector<tile_queue>& queues, size_t self){
+    for (size_t k = 1; k < queues.size(); k++) {
+        tile_queue& victim = queues[(self + k) % queues.size()];
+        int begin, end;
+        {
+            lock_guard<mutex> guard(victim.lock);
+            int left = victim.end - victim.begin;
+            if (left == 0) {
+                continue;
+            }
+            end = victim.end;
+            begin = victim.end - (left + 1) / 2;
+            victim.end = begin;
+        }
+        lock_guard<mutex> guard(queues[self].lock);
+        queues[self].begin = begin;
+        queues[self].end = end;
+        return true;
+    }
+    return false; // Tiles are never added, so once every queue is empty the frame is done
+}
+
+} // namespace
+
+void mandelbrot_for_each_tile(int width, int height, const mandelbrot_render_options& options,
+                              const mandelbrot_tile_fn& work){
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    int tile_w = options.tile_width > 0 ? options.tile_width : default_tile_width;
+    int tile_h = options.tile_height > 0 ? options.tile_height : default_tile_height;
+    int tiles_x = (width + tile_w - 1) / tile_w;
+    int tiles_y = (height + tile_h - 1) / tile_h;
+    int tiles = tiles_x * tiles_y;
+
+    int threads = options.threads;
+    if (threads <= 0) {
+        threads = max(1, (int)thread::hardware_concurrency());
+    }
+    threads = min(threads, tiles);
+
+    vector<tile_queue> queues(threads);
+    for (int t = 0; t < threads; t++) {
+        queues[t].begin = (int)((long long)tiles * t / threads);
+        queues[t].end = (int)((long long)tiles * (t + 1) / threads);
+    }
+
+    auto worker = [&](size_t self) {
+        int tile;
+        for (;;) {
+            if (!pop_front(queues[self], tile)) {
+                if (!steal(queues, self)) {
+                    return;
+                }
+                continue; // The stolen run may itself be stolen from before we pop it
+            }
+            int x0 = (tile % tiles_x) * tile_w;
+            int y0 = (tile / tiles_x) * tile_h;
+            work(x0, y0, min(tile_w, width - x0), min(tile_h, height - y0));
+        }
+    };
+
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker, (size_t)t);
+    }
+    worker(0);
+    for (thread& th : pool) {
+        th.join();
+    }
+}
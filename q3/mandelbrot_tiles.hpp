@@ -0,0 +1,20 @@
+#ifndef MANDELBROT_TILES_HPP
+#define MANDELBROT_TILES_HPP
+
+// Internal to libmandelbrot.so: work-stealing tile scheduler.
+
+#include <functional>
+#include "mandelbrot.hpp"
+
+// Receives one tile: the pixels [x0, x0 + w) x [y0, y0 + h)
+typedef std::function<void(int x0, int y0, int w, int h)> mandelbrot_tile_fn;
+
+// Cuts a width x height grid into tiles and runs work on each of them exactly
+// once, spread over options.threads threads (the calling thread included).
+// Every thread starts with a contiguous run of tiles and, once it runs out,
+// steals half of the remaining run of another thread, so rows near the set
+// boundary that cost far more than the rest do not leave threads idle.
+void mandelbrot_for_each_tile(int width, int height, const mandelbrot_render_options& options,
+                              const mandelbrot_tile_fn& work);
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * Benchmark for the shortest-path engines
+ *
+ * Generates synthetic graphs and runs every engine on every graph, each
+ * combination in a forked child so that its peak memory is its own. Writes
+ * one CSV row per combination to stdout:
+ *
+ *   graph,vertices,arcs,engine,load_s,build_s,query_s,p2p_s,arcs_per_s,peak_rss_kb
+ *
+ * load_s maps and checks the graph written as a binary graph file (the
+ * --graph path), build_s packs the edge list into a CSR graph plus any
+ * preprocessing the engine needs (the contraction hierarchy for "ch"),
+ * query_s is the mean time of a full single-source run and p2p_s of a
+ * point-to-point query between random vertices. arcs_per_s is the number of
+ * arc relaxations the engine counted during the full runs (SearchStats),
+ * per second of query time. peak_rss_kb is the peak resident memory from the
+ * moment the graph is built to the end of the queries: the generator's edge
+ * list is freed and the kernel's high-water mark reset before the engine is
+ * made, so it covers the CSR graph, the engine and its queries.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "graph.hpp"
+#include "dijkstra.hpp"
+#include "delta_stepping.hpp"
+#include "ch.hpp"
+
+using namespace std;
+
+#ifndef MYDIJKSTRA_DIST
+#define MYDIJKSTRA_DIST int
+#endif
+typedef MYDIJKSTRA_DIST Dist;
+
+// Weights are drawn from [1, max_weight]
+static const int max_weight = 100;
+
+// side x side grid, 4-neighbour
+static vector<Edge> grid_graph(int V, mt19937_64 &rng){
+    int side = max(1, (int)sqrt((double)V));
+    uniform_int_distribution<int> weight(1, max_weight);
+    vector<Edge> edges;
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            int v = y * side + x;
+            if (x + 1 < side)
+                edges.push_back({v, v + 1, weight(rng)});
+            if (y + 1 < side)
+                edges.push_back({v, v + side, weight(rng)});
+        }
+    }
+    return edges;
+}
+
+// E edges between uniformly random endpoints
+static vector<Edge> random_graph(int V, long long E, mt19937_64 &rng){
+    uniform_int_distribution<int> vertex(0, V - 1), weight(1, max_weight);
+    vector<Edge> edges;
+    edges.reserve(E);
+    for (long long i = 0; i < E; i++)
+        edges.push_back({vertex(rng), vertex(rng), weight(rng)});
+    return edges;
+}
+
+// Preferential attachment (Barabasi-Albert): every new vertex links to m
+// earlier ones picked in proportion to their degree, which gives a few hubs
+// with very high degree
+static vector<Edge> scale_free_graph(int V, long long E, mt19937_64 &rng){
+    int m = max(1LL, E / max(1, V));
+    uniform_int_distribution<int> weight(1, max_weight);
+    vector<Edge> edges;
+    vector<int> endpoints; // every vertex once per incident edge
+    for (int v = 1; v < V; v++) {
+        for (int k = 0; k < m; k++) {
+            int u = endpoints.empty() ? 0 : endpoints[uniform_int_distribution<size_t>(0, endpoints.size() - 1)(rng)];
+            edges.push_back({v, u, weight(rng)});
+            endpoints.push_back(u);
+            endpoints.push_back(v);
+        }
+    }
+    return edges;
+}
+
+// A jittered grid with some streets missing, weights proportional to length,
+// and every eighth row and column a faster highway
+static vector<Edge> road_graph(int V, mt19937_64 &rng){
+    int side = max(1, (int)sqrt((double)V));
+    uniform_real_distribution<double> jitter(-0.3, 0.3), coin(0, 1);
+    vector<double> px(side * side), py(side * side);
+    for (int v = 0; v < side * side; v++) {
+        px[v] = v % side + jitter(rng);
+        py[v] = v / side + jitter(rng);
+    }
+    vector<Edge> edges;
+    auto link = [&](int a, int b, bool highway) {
+        double length = hypot(px[a] - px[b], py[a] - py[b]);
+        int w = max(1, (int)lround(length * (highway ? 10 : 30)));
+        edges.push_back({a, b, w});
+    };
+    for (int y = 0; y < side; y++) {
+        for (int x = 0; x < side; x++) {
+            int v = y * side + x;
+            if (x + 1 < side && (y % 8 == 0 || coin(rng) < 0.85))
+                link(v, v + 1, y % 8 == 0);
+            if (y + 1 < side && (x % 8 == 0 || coin(rng) < 0.85))
+                link(v, v + side, x % 8 == 0);
+        }
+    }
+    return edges;
+}
+
+static double seconds_since(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Restarts the high-water mark of /proc/self/status (VmHWM) at the current
+// resident size
+static bool reset_peak_rss(){
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f == nullptr)
+        return false;
+    bool ok = fputs("5", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+// VmHWM in kB, -1 if it can't be read
+static long peak_rss(){
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == nullptr)
+        return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f) != nullptr)
+        if (sscanf(line, "VmHWM: %ld", &kb) == 1)
+            break;
+    fclose(f);
+    return kb;
+}
+
+struct Config {
+    int vertices;
+    long long edges;
+    int runs;      // full single-source runs per engine
+    int p2p;       // point-to-point queries per engine
+    int threads;   // for delta-stepping
+    int ch_max_vertices; // larger graphs skip "ch", whose preprocessing grows faster than linearly
+    unsigned long long seed;
+};
+
+// Runs one engine on one graph and prints its row. Runs in a forked child.
+static int bench_one(const string &kind, const string &engine_name, const Config &config){
+    if (engine_name == "ch" && config.vertices > config.ch_max_vertices) {
+        fprintf(stderr, "Skipping engine ch on %s: more than %d vertices (--ch-max-vertices)\n", kind.c_str(),
+                config.ch_max_vertices);
+        return 0;
+    }
+    mt19937_64 rng(config.seed);
+    vector<Edge> edges;
+    if (kind == "grid") {
+        edges = grid_graph(config.vertices, rng);
+    } else if (kind == "random") {
+        edges = random_graph(config.vertices, config.edges, rng);
+    } else if (kind == "scalefree") {
+        edges = scale_free_graph(config.vertices, config.edges, rng);
+    } else if (kind == "road") {
+        edges = road_graph(config.vertices, rng);
+    } else {
+        fprintf(stderr, "Unknown graph kind %s\n", kind.c_str());
+        return 1;
+    }
+    int V = 0;
+    for (const Edge &e : edges)
+        V = max(V, max(e.u, e.v) + 1);
+    V = max(V, kind == "grid" || kind == "road" ? 1 : config.vertices);
+
+    auto start = chrono::steady_clock::now();
+    CsrGraph graph = CsrGraph::from_edges(V, edges);
+    double build = seconds_since(start);
+    vector<Edge>().swap(edges);
+
+    // Load time: the same graph through a binary graph file
+    char path[] = "/tmp/dijkstra_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    string error;
+    if (!graph.save(path, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        unlink(path);
+        return 1;
+    }
+    CsrGraph loaded;
+    start = chrono::steady_clock::now();
+    bool ok = CsrGraph::load(path, loaded, error);
+    double load = seconds_since(start);
+    unlink(path);
+    if (!ok) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    loaded = CsrGraph();
+
+    // Generation and the loaded copy are gone; from here on the peak is
+    // the engine's. Without clear_refs the peak of the whole child remains.
+    bool peak_reset = reset_peak_rss();
+
+    unique_ptr<ShortestPaths<Dist>> engine;
+    DeltaSteppingEngine<Dist> *delta = nullptr;
+    CsrGraph upward;
+    start = chrono::steady_clock::now();
+    QueueKind queue;
+    if (engine_name == "delta") {
+        delta = new DeltaSteppingEngine<Dist>(graph, config.threads, 0);
+        engine.reset(delta);
+    } else if (engine_name == "ch") {
+        ChBuilder builder(graph);
+        upward = builder.build();
+        engine.reset(new ChEngine<Dist>(upward));
+    } else if (parse_queue_kind(engine_name.c_str(), queue)) {
+        engine = make_engine<Dist>(graph, queue);
+    }
+    build += seconds_since(start);
+    if (engine == nullptr) {
+        fprintf(stderr, "Skipping engine %s: not available\n", engine_name.c_str());
+        return 0;
+    }
+
+    uniform_int_distribution<int> vertex(0, V - 1);
+    double query = 0;
+    long long relaxed = engine->stats().relaxations;
+    for (int r = 0; r < config.runs; r++) {
+        int src = vertex(rng);
+        start = chrono::steady_clock::now();
+        engine->run(src);
+        query += seconds_since(start);
+    }
+    double arcs = engine->stats().relaxations - relaxed;
+    // With several threads each must settle part of the buckets, or the
+    // engine has silently become sequential
+    if (delta != nullptr && delta->thread_count() > 1 && config.runs > 0) {
+        long long total = 0;
+        int busy = 0;
+        for (long long count : delta->settled_per_thread()) {
+            total += count;
+            busy += count > 0;
+        }
+        if (total >= 1000 && busy < 2) {
+            fprintf(stderr, "%s/delta: one of %d threads settled all %lld vertices\n", kind.c_str(),
+                    delta->thread_count(), total);
+            return 1;
+        }
+    }
+
+    double p2p = 0;
+    for (int q = 0; q < config.p2p; q++) {
+        int src = vertex(rng), dst = vertex(rng);
+        start = chrono::steady_clock::now();
+        engine->point_to_point(src, dst);
+        p2p += seconds_since(start);
+    }
+
+    long peak = peak_reset ? peak_rss() : -1;
+    if (peak < 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak = usage.ru_maxrss;
+    }
+    printf("%s,%d,%zu,%s,%.6f,%.6f,%.6f,%.9f,%.6g,%ld\n", kind.c_str(), V, graph.num_arcs(),
+           engine_name.c_str(), load, build, config.runs > 0 ? query / config.runs : 0.0,
+           config.p2p > 0 ? p2p / config.p2p : 0.0, query > 0 ? arcs / query : 0.0, peak);
+    fflush(stdout);
+    return 0;
+}
+
+static vector<string> split(const char *text){
+    vector<string> items;
+    string s(text);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == string::npos)
+            comma = s.size();
+        if (comma > start)
+            items.push_back(s.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+int main(int argc, char *argv[]){
+    vector<string> graphs = split("grid,random,scalefree,road");
+    vector<string> engines = split("binary,dary,radix,dial,delta");
+    Config config = {100000, 400000, 5, 50, 0, 200000, 1};
+
+    for (int i = 1; i < argc; i++) {
+        const char *next = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (next == nullptr) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--graphs") == 0) {
+            graphs = split(next);
+        } else if (strcmp(argv[i], "--engines") == 0) {
+            engines = split(next);
+        } else if (strcmp(argv[i], "--vertices") == 0) {
+            config.vertices = max(1, atoi(next));
+        } else if (strcmp(argv[i], "--edges") == 0) {
+            config.edges = max(0LL, atoll(next));
+        } else if (strcmp(argv[i], "--runs") == 0) {
+            config.runs = max(0, atoi(next));
+        } else if (strcmp(argv[i], "--p2p") == 0) {
+            config.p2p = max(0, atoi(next));
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            config.threads = atoi(next);
+        } else if (strcmp(argv[i], "--ch-max-vertices") == 0) {
+            config.ch_max_vertices = max(0, atoi(next));
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            config.seed = strtoull(next, nullptr, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [--graphs grid,random,scalefree,road] [--engines binary,dary,radix,dial,delta,ch]"
+                            " [--vertices V] [--edges E] [--runs R] [--p2p Q] [--threads T] [--ch-max-vertices N] [--seed S]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    printf("graph,vertices,arcs,engine,load_s,build_s,query_s,p2p_s,arcs_per_s,peak_rss_kb\n");
+    fflush(stdout);
+    int failures = 0;
+    for (const string &kind : graphs) {
+        for (const string &engine : engines) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                return 1;
+            }
+            if (pid == 0)
+                _exit(bench_one(kind, engine, config));
+            int status;
+            if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "%s/%s failed\n", kind.c_str(), engine.c_str());
+                failures++;
+            }
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,441 @@
+#ifndef CH_HPP
+#define CH_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+#include "dijkstra.hpp"
+#include "queues.hpp"
+
+// Contraction hierarchies (Geisberger et al.) for the undirected graphs
+// myDijkstra reads.
+//
+// Preprocessing removes ("contracts") the vertices one at a time, cheapest
+// first. Removing v adds a shortcut u-w of weight w(u, v) + w(v, w) between
+// two of its remaining neighbours unless a witness search finds a path at
+// least as short that avoids v. Every vertex gets its position in that order
+// as its rank, and the result is stored as the upward graph: an ordinary CSR
+// graph of all original and shortcut edges, each kept only as the arc from
+// its lower-ranked end to its higher-ranked one, plus the ranks.
+//
+// Some shortest path between any two vertices then climbs in rank and comes
+// back down, so a query is two searches that only go upwards, one from each
+// end, meeting at the top. Vertices left in the core (see
+// ChBuilder::core_degree_limit) keep their arcs both ways, so above the
+// contracted vertices the searches walk the core as a plain graph.
+
+// Builds the upward graph of a contraction hierarchy
+class ChBuilder {
+public:
+    // A witness search gives up after settling this many vertices or going
+    // this many arcs deep, and the shortcut is added anyway, which costs
+    // query time but never correctness. Estimating a priority only needs a
+    // rough count, so it looks less far.
+    static const int witness_settle_limit = 100;
+    static const int witness_hop_limit = 5;
+    static const int priority_settle_limit = 50;
+    static const int priority_hop_limit = 2;
+
+    // Contraction stops once the cheapest vertex left has more neighbours
+    // than this. What remains is the core: its vertices get the top ranks in
+    // any order and keep their edges in both directions, so queries search
+    // it like a plain graph. Graphs without geometric structure (random,
+    // scale-free) shrink to a dense core whose contraction would add a
+    // shortcut between most pairs of its vertices, at cubic cost.
+    static const int core_degree_limit = 16;
+
+    // Witness searches reach vertices with more neighbours than this but
+    // don't go on through them: scanning the lists of the hubs waiting in
+    // the core is most of the preprocessing time on scale-free graphs
+    static const int witness_degree_limit = 4 * core_degree_limit;
+
+    explicit ChBuilder(const CsrGraph &graph)
+        : V(graph.num_vertices()), adj(V), deleted_neighbors(V, 0), position(V, -1),
+          witness_dist(V, 0), witness_hops(V, 0), witness_stamp(V, 0), target_stamp(V, 0), epoch(0),
+          shortcuts(0), core(0), too_long(false) {
+        // Keep the lightest of any parallel edges and drop self loops
+        for (int u = 0; u < V; ++u) {
+            for (const Arc *x = graph.begin(u); x != graph.end(u); ++x)
+                if (x->to != u)
+                    adj[u].push_back({x->to, x->weight});
+            std::sort(adj[u].begin(), adj[u].end(), [](const Neighbor &a, const Neighbor &b) {
+                return a.v < b.v || (a.v == b.v && a.w < b.w);
+            });
+            adj[u].erase(std::unique(adj[u].begin(), adj[u].end(),
+                                     [](const Neighbor &a, const Neighbor &b) { return a.v == b.v; }),
+                         adj[u].end());
+        }
+    }
+
+    CsrGraph build() {
+        typedef std::pair<int, int> Item; // (priority, vertex)
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> order;
+        std::vector<int> current(V);
+        for (int v = 0; v < V; ++v) {
+            current[v] = priority(v);
+            order.push({current[v], v});
+        }
+
+        std::vector<uint32_t> rank(V, 0);
+        std::vector<bool> contracted(V, false);
+        std::vector<Edge> upward;
+        uint32_t next_rank = 0;
+        while (!order.empty()) {
+            int v = order.top().second;
+            int p = order.top().first;
+            order.pop();
+            // An entry left behind when v's priority changed
+            if (contracted[v] || p != current[v])
+                continue;
+            if (p == core_priority)
+                break;
+
+            contract(v, true);
+            rank[v] = next_rank++;
+            contracted[v] = true;
+            std::vector<Neighbor> nb;
+            nb.swap(adj[v]);
+            for (const Neighbor &n : nb)
+                upward.push_back({v, n.v, n.w});
+
+            // The shortcuts by the neighbour they start from, in neighbour order
+            std::sort(pending.begin(), pending.end(), [](const Edge &a, const Edge &b) { return a.u < b.u; });
+            size_t first = 0;
+            for (int i = 0; i < (int)nb.size(); ++i) {
+                size_t last = first;
+                while (last < pending.size() && pending[last].u == i)
+                    ++last;
+                update_neighbors(nb[i].v, v, first, last);
+                first = last;
+            }
+            pending.clear();
+
+            // Only the neighbours' priorities change: they lost v, gained the
+            // shortcuts and have one more contracted neighbour
+            for (const Neighbor &n : nb) {
+                deleted_neighbors[n.v]++;
+                current[n.v] = priority(n.v);
+                order.push({current[n.v], n.v});
+            }
+        }
+
+        // Everything left is the core; each edge is kept from both ends
+        for (int v = 0; v < V; ++v) {
+            if (contracted[v])
+                continue;
+            rank[v] = next_rank++;
+            core++;
+            for (const Neighbor &n : adj[v])
+                upward.push_back({v, n.v, n.w});
+        }
+
+        CsrGraph g = CsrGraph::from_arcs(V, upward);
+        g.set_ranks(rank, core > 0 ? (uint32_t)(V - core) : csr_no_core);
+        return g;
+    }
+
+    long long num_shortcuts() const { return shortcuts; }
+
+    // Vertices left uncontracted by the last build()
+    int core_size() const { return core; }
+
+    // A shortcut was longer than an arc weight can hold, so the hierarchy
+    // built is missing it and must not be used
+    bool overflowed() const { return too_long; }
+
+private:
+    struct Neighbor {
+        int v;
+        int w;
+    };
+
+    int V;
+    std::vector<std::vector<Neighbor>> adj; // the graph not contracted yet
+    std::vector<int> deleted_neighbors;
+    // Shortcuts of the vertex being contracted, both directions; u is the
+    // index of the neighbour the shortcut starts from in the vertex's list
+    std::vector<Edge> pending;
+    std::vector<int> position;  // index of each vertex in the list being updated, -1 elsewhere
+
+    // Distances of the witness search, valid where the stamp is the epoch
+    std::vector<long long> witness_dist;
+    std::vector<int> witness_hops;
+    std::vector<uint32_t> witness_stamp;
+    std::vector<uint32_t> target_stamp; // the neighbours the search is looking for
+    std::vector<std::pair<long long, int>> witness_heap;
+    uint32_t epoch;
+    long long shortcuts;
+    int core;
+    bool too_long;
+
+    // Priority of a vertex with more than core_degree_limit neighbours
+    static const int core_priority = INT_MAX;
+
+    // Edge difference (shortcuts added minus edges removed) plus the number
+    // of neighbours already contracted, which spreads contraction evenly
+    int priority(int v) {
+        if ((int)adj[v].size() > core_degree_limit)
+            return core_priority;
+        return contract(v, false) - (int)adj[v].size() + deleted_neighbors[v];
+    }
+
+    // Counts the shortcuts contracting v needs, and puts them in pending when apply
+    int contract(int v, bool apply) {
+        const std::vector<Neighbor> &nb = adj[v];
+        int needed = 0;
+        for (size_t i = 0; i + 1 < nb.size(); ++i) {
+            next_epoch();
+            long long limit = 0;
+            for (size_t j = i + 1; j < nb.size(); ++j) {
+                limit = std::max(limit, (long long)nb[i].w + nb[j].w);
+                target_stamp[nb[j].v] = epoch;
+            }
+            witness_search(nb[i].v, v, limit, (int)(nb.size() - i - 1),
+                           apply ? witness_settle_limit : priority_settle_limit,
+                           apply ? witness_hop_limit : priority_hop_limit);
+            for (size_t j = i + 1; j < nb.size(); ++j) {
+                long long via = (long long)nb[i].w + nb[j].w;
+                if (reached(nb[j].v) <= via)
+                    continue;
+                ++needed;
+                if (apply && via > INT_MAX) {
+                    too_long = true;
+                } else if (apply) {
+                    pending.push_back({(int)i, nb[j].v, (int)via});
+                    pending.push_back({(int)j, nb[i].v, (int)via});
+                    ++shortcuts;
+                }
+            }
+        }
+        return needed;
+    }
+
+    long long reached(int v) const {
+        return witness_stamp[v] == epoch ? witness_dist[v] : LLONG_MAX;
+    }
+
+    void next_epoch() {
+        if (++epoch == 0) {
+            std::fill(witness_stamp.begin(), witness_stamp.end(), 0);
+            std::fill(target_stamp.begin(), target_stamp.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    // Dijkstra from source in the remaining graph, never entering skip. Stops
+    // past limit, after settle_limit vertices or once all targets (the
+    // vertices marked in target_stamp) are settled, and follows no path of
+    // more than hop_limit arcs or through a vertex past witness_degree_limit
+    // (other than source).
+    void witness_search(int source, int skip, long long limit, int targets, int settle_limit, int hop_limit) {
+        typedef std::pair<long long, int> Item;
+        std::vector<Item> &heap = witness_heap;
+        heap.clear();
+        witness_dist[source] = 0;
+        witness_hops[source] = 0;
+        witness_stamp[source] = epoch;
+        heap.push_back({0, source});
+        int settled = 0;
+        while (!heap.empty() && settled < settle_limit && targets > 0) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Item>());
+            long long du = heap.back().first;
+            int u = heap.back().second;
+            heap.pop_back();
+            if (du != witness_dist[u])
+                continue;
+            if (du > limit)
+                break;
+            ++settled;
+            if (target_stamp[u] == epoch)
+                --targets;
+            if (witness_hops[u] == hop_limit || (u != source && (int)adj[u].size() > witness_degree_limit))
+                continue;
+            for (const Neighbor &n : adj[u]) {
+                if (n.v == skip)
+                    continue;
+                long long dv = du + n.w;
+                if (dv < reached(n.v)) {
+                    witness_dist[n.v] = dv;
+                    witness_hops[n.v] = witness_hops[u] + 1;
+                    witness_stamp[n.v] = epoch;
+                    heap.push_back({dv, n.v});
+                    std::push_heap(heap.begin(), heap.end(), std::greater<Item>());
+                }
+            }
+        }
+    }
+
+    // Takes the contracted v out of u's list and merges in pending[first, last),
+    // the shortcuts from u, each in O(1) through position
+    void update_neighbors(int u, int v, size_t first, size_t last) {
+        std::vector<Neighbor> &list = adj[u];
+        for (size_t k = 0; k < list.size(); ++k)
+            position[list[k].v] = (int)k;
+        for (size_t k = first; k < last; ++k) {
+            const Edge &e = pending[k];
+            int at = position[e.v];
+            if (at < 0) {
+                position[e.v] = (int)list.size();
+                list.push_back({e.v, e.w});
+            } else {
+                list[at].w = std::min(list[at].w, e.w);
+            }
+        }
+        int at = position[v];
+        position[list.back().v] = at;
+        list[at] = list.back();
+        list.pop_back();
+        position[v] = -1;
+        for (const Neighbor &n : list)
+            position[n.v] = -1;
+    }
+};
+
+// Queries on the upward graph of a contraction hierarchy.
+//
+// point_to_point() searches upwards from both ends and stops each side once
+// its next vertex is no closer than the best meeting point found. A vertex is
+// not expanded when a higher-ranked neighbour already reaches it more cheaply
+// ("stall on demand"): its upward label can't be on a shortest path.
+//
+// run() computes all distances from src (PHAST): one upward search, then a
+// sweep over the vertices from the highest rank down, where every vertex
+// takes the best of its upward distance and of its higher neighbours'
+// final distances plus the arc between them.
+template <class D>
+class ChEngine : public ShortestPaths<D> {
+public:
+    explicit ChEngine(const CsrGraph &upward)
+        : graph(upward), order(upward.num_vertices()), dist(upward.num_vertices(), dist_infinity<D>()),
+          epoch(0) {
+        int V = upward.num_vertices();
+        for (int v = 0; v < V; ++v)
+            order[V - 1 - upward.rank(v)] = v;
+        for (int side = 0; side < 2; ++side) {
+            queues[side].reset(new IndexedDaryHeap<D, 4>(V, 0));
+            labels[side].assign(V, Label{0, 0});
+        }
+    }
+
+    void run(int src) override {
+        next_epoch();
+        upward_search(0, src);
+        // Core arcs also lead to lower ranks, whose distances of the last
+        // run must not count
+        std::fill(dist.begin(), dist.end(), dist_infinity<D>());
+        this->counters.relaxations += graph.num_arcs();
+        for (int v : order) {
+            D best = reached(0, v);
+            for (const Arc *x = graph.begin(v); x != graph.end(v); ++x)
+                best = std::min(best, dist_add(dist[x->to], x->weight));
+            dist[v] = best;
+        }
+    }
+
+    D distance(int v) const override {
+        return dist[v];
+    }
+
+    D point_to_point(int src, int dst) override {
+        next_epoch();
+        D best = dist_infinity<D>();
+        int ends[2] = {src, dst};
+        for (int side = 0; side < 2; ++side) {
+            queues[side]->clear();
+            queues[side]->push(ends[side], 0);
+            labels[side][ends[side]] = Label{0, epoch};
+        }
+        // Alternate between the sides while either can still improve best
+        bool open[2] = {true, true};
+        for (int side = 0; open[0] || open[1]; side ^= 1) {
+            if (!open[side])
+                continue;
+            open[side] = step(side, best);
+        }
+        dist[dst] = best;
+        return best;
+    }
+
+    D bidirectional(int src, int dst) override {
+        return point_to_point(src, dst);
+    }
+
+private:
+    struct Label {
+        D dist;
+        uint32_t stamp;
+    };
+
+    const CsrGraph &graph;
+    std::vector<int> order; // vertices from the highest rank down
+    std::vector<D> dist;    // result of the last run()
+    std::unique_ptr<IndexedDaryHeap<D, 4>> queues[2];
+    std::vector<Label> labels[2];
+    uint32_t epoch;
+
+    void next_epoch() {
+        if (++epoch == 0) {
+            for (int side = 0; side < 2; ++side)
+                for (Label &l : labels[side])
+                    l.stamp = 0;
+            epoch = 1;
+        }
+    }
+
+    D reached(int side, int v) const {
+        return labels[side][v].stamp == epoch ? labels[side][v].dist : dist_infinity<D>();
+    }
+
+    // Upward search from src until the queue runs dry
+    void upward_search(int side, int src) {
+        queues[side]->clear();
+        queues[side]->push(src, 0);
+        labels[side][src] = Label{0, epoch};
+        D best = dist_infinity<D>();
+        while (step(side, best)) {
+        }
+    }
+
+    // Settles the next vertex of one side and relaxes its upward arcs,
+    // updating best with paths that meet the other side. Returns false once
+    // the side is exhausted or can no longer beat best.
+    bool step(int side, D &best) {
+        IndexedDaryHeap<D, 4> &pq = *queues[side];
+        if (pq.empty())
+            return false;
+        int u;
+        D du;
+        pq.pop(u, du);
+        if (du >= best)
+            return false;
+
+        // du < best, so the difference can't overflow
+        D meet = reached(side ^ 1, u);
+        if (meet < best - du)
+            best = du + meet;
+
+        // Stall on demand: a higher neighbour reaching u more cheaply means
+        // this label is not on a shortest path, so don't expand it
+        for (const Arc *x = graph.begin(u); x != graph.end(u); ++x)
+            if (dist_add(reached(side, x->to), x->weight) < du)
+                return true;
+
+        this->counters.relaxations += graph.end(u) - graph.begin(u);
+        for (const Arc *x = graph.begin(u); x != graph.end(u); ++x) {
+            D nd = dist_add(du, x->weight);
+            if (nd < reached(side, x->to)) {
+                labels[side][x->to] = Label{nd, epoch};
+                pq.push(x->to, nd);
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef DELTA_STEPPING_HPP
+#define DELTA_STEPPING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "graph.hpp"
+#include "dijkstra.hpp"
+
+// Reusable barrier for a fixed number of threads
+class ThreadBarrier {
+public:
+    explicit ThreadBarrier(int count) : count(count), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned gen = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            ++generation;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&] { return gen != generation; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int count;
+    int waiting;
+    unsigned generation;
+};
+
+// Parallel delta-stepping (Meyer and Sanders). Tentative distances are
+// grouped into buckets of width delta, and the lowest non-empty bucket is
+// settled in rounds: at the start of a round every thread takes its part of
+// the bucket out, and after a barrier each settles an equal slice of all the
+// parts together, relaxing the light arcs (weight <= delta) of those
+// vertices, which can only put vertices back into the same or a later
+// bucket. Once the bucket stays empty the heavy arcs of everything it settled
+// are relaxed once. Distances are lowered with an atomic compare-and-swap,
+// and a vertex goes into the bucket of the thread that lowered it, so no
+// bucket is ever written by two threads. Threads meet at a barrier after
+// every round.
+//
+// All live distances lie within max weight of the bucket being settled, so
+// each thread keeps max_weight / delta + 2 circular buckets. A delta too small
+// for that to stay under max_buckets is raised until it fits.
+template <class D>
+class DeltaSteppingEngine : public ShortestPaths<D> {
+public:
+    static const int max_buckets = 1 << 16;
+
+    // threads <= 0 uses every hardware thread; delta <= 0 picks one from the
+    // weights (the mean arc weight, at least 1)
+    DeltaSteppingEngine(const CsrGraph &graph, int threads, int delta)
+        : graph(graph), dist(graph.num_vertices()) {
+        int hw = (int)std::thread::hardware_concurrency();
+        num_threads = threads > 0 ? threads : std::max(1, hw);
+
+        long long total = 0;
+        int max_weight = 0;
+        for (int u = 0; u < graph.num_vertices(); ++u)
+            for (const Arc *x = graph.begin(u); x != graph.end(u); ++x) {
+                total += x->weight;
+                max_weight = std::max(max_weight, x->weight);
+            }
+        if (delta <= 0)
+            delta = graph.num_arcs() > 0 ? (int)std::max(1LL, total / (long long)graph.num_arcs()) : 1;
+        while ((long long)max_weight / delta + 2 > max_buckets)
+            delta = (int)std::min<long long>(INT_MAX, 2LL * delta);
+        this->delta = delta;
+        num_buckets = max_weight / delta + 2;
+        workers.resize(num_threads);
+        for (Worker &w : workers)
+            w.buckets.resize(num_buckets);
+    }
+
+    void run(int src) override {
+        for (std::atomic<D> &d : dist)
+            d.store(dist_infinity<D>(), std::memory_order_relaxed);
+        for (Worker &w : workers) {
+            for (auto &bucket : w.buckets)
+                bucket.clear();
+            w.settled_count = 0;
+            w.relaxations = 0;
+        }
+        dist[src].store(0, std::memory_order_relaxed);
+        workers[0].buckets[0].push_back({src, 0});
+
+        current = 0;
+        done = false;
+        ThreadBarrier barrier(num_threads);
+        std::vector<std::thread> threads;
+        for (int t = 1; t < num_threads; ++t)
+            threads.emplace_back([&, t] { work(t, barrier); });
+        work(0, barrier);
+        for (std::thread &th : threads)
+            th.join();
+        for (const Worker &w : workers)
+            this->counters.relaxations += w.relaxations;
+    }
+
+    D distance(int v) const override {
+        return dist[v].load(std::memory_order_relaxed);
+    }
+
+    // Delta-stepping has no cheap early exit: both run the full search
+    D point_to_point(int src, int dst) override {
+        run(src);
+        return distance(dst);
+    }
+
+    D bidirectional(int src, int dst) override {
+        return point_to_point(src, dst);
+    }
+
+    int bucket_width() const { return delta; }
+    int thread_count() const { return num_threads; }
+
+    // Vertices each thread settled in the last run()
+    std::vector<long long> settled_per_thread() const {
+        std::vector<long long> counts;
+        for (const Worker &w : workers)
+            counts.push_back(w.settled_count);
+        return counts;
+    }
+
+private:
+    // (vertex, distance it was queued with); stale when the distance moved on
+    typedef std::pair<int, D> Entry;
+
+    struct Worker {
+        std::vector<std::vector<Entry>> buckets;
+        std::vector<Entry> frontier; // its part of the bucket, taken out at the start of the round
+        std::vector<Entry> settled;  // everything it settled from the bucket, for the heavy arcs
+        long long settled_count = 0;
+        long long relaxations = 0;  // added to the engine's stats once the threads are done
+    };
+
+    const CsrGraph &graph;
+    std::vector<std::atomic<D>> dist;
+    int num_threads;
+    int delta;
+    int num_buckets;
+    std::vector<Worker> workers;
+
+    // Shared state, only written by thread 0 between barriers
+    long long current; // index of the bucket being settled
+    bool more;         // the current bucket was refilled in the last round
+    bool done;
+
+    size_t slot(D d) const {
+        return (size_t)(long long)(d / delta) % num_buckets;
+    }
+
+    void relax(Worker &me, int v, D nd) {
+        me.relaxations++;
+        D old = dist[v].load(std::memory_order_relaxed);
+        while (nd < old) {
+            if (dist[v].compare_exchange_weak(old, nd, std::memory_order_relaxed)) {
+                me.buckets[slot(nd)].push_back({v, nd});
+                return;
+            }
+        }
+    }
+
+    // Settles e unless it is stale, relaxing its light arcs
+    void settle(Worker &me, const Entry &e) {
+        int u = e.first;
+        D du = e.second;
+        if (dist[u].load(std::memory_order_relaxed) != du)
+            return;
+        me.settled.push_back(e);
+        me.settled_count++;
+        for (const Arc *x = graph.begin(u); x != graph.end(u); ++x)
+            if (x->weight <= delta)
+                relax(me, x->to, dist_add(du, x->weight));
+    }
+
+    bool bucket_empty(long long index) const {
+        for (const Worker &w : workers)
+            if (!w.buckets[(size_t)index % num_buckets].empty())
+                return false;
+        return true;
+    }
+
+    void work(int t, ThreadBarrier &barrier) {
+        Worker &me = workers[t];
+        while (!done) {
+            // Settle the current bucket, light arcs only, until nobody refills it
+            for (;;) {
+                me.frontier.clear();
+                me.frontier.swap(me.buckets[(size_t)(current % num_buckets)]);
+                barrier.wait();
+
+                // Every part is out (and no longer written): take slice t of
+                // the parts laid end to end
+                size_t total = 0;
+                for (const Worker &w : workers)
+                    total += w.frontier.size();
+                size_t begin = total * t / num_threads, end = total * (t + 1) / num_threads;
+                size_t offset = 0;
+                for (const Worker &w : workers) {
+                    size_t from = std::max(begin, offset), to = std::min(end, offset + w.frontier.size());
+                    for (size_t k = from; k < to; ++k)
+                        settle(me, w.frontier[k - offset]);
+                    offset += w.frontier.size();
+                }
+                barrier.wait();
+                if (t == 0)
+                    more = !bucket_empty(current);
+                barrier.wait();
+                if (!more)
+                    break;
+            }
+
+            // Heavy arcs always land in a later bucket, so once is enough
+            for (const Entry &e : me.settled) {
+                int u = e.first;
+                D du = e.second;
+                if (dist[u].load(std::memory_order_relaxed) != du)
+                    continue;
+                for (const Arc *x = graph.begin(u); x != graph.end(u); ++x)
+                    if (x->weight > delta)
+                        relax(me, x->to, dist_add(du, x->weight));
+            }
+            me.settled.clear();
+            barrier.wait();
+
+            if (t == 0) {
+                long long next = current + 1;
+                while (next < current + num_buckets && bucket_empty(next))
+                    ++next;
+                done = (next == current + num_buckets);
+                current = next;
+            }
+            barrier.wait();
+        }
+    }
+};
+
+// Returns shortest distances from src to all other vertices, computed with
+// delta-stepping on the given number of threads
+template <class D = int>
+std::vector<D> delta_stepping(const CsrGraph &graph, int src, int threads, int delta){
+    DeltaSteppingEngine<D> engine(graph, threads, delta);
+    engine.run(src);
+    std::vector<D> result(graph.num_vertices());
+    for (int v = 0; v < graph.num_vertices(); ++v)
+        result[v] = engine.distance(v);
+    return result;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef DIJKSTRA_HPP
+#define DIJKSTRA_HPP
+
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include "distance.hpp"
+#include "graph.hpp"
+#include "queues.hpp"
+
+// Work done by an engine, summed over all its searches
+struct SearchStats {
+    long long relaxations = 0; // arcs followed to try to lower a distance
+};
+
+// Shortest distances from one source at a time, over a graph that stays
+// loaded between queries. D is the distance type (see distance.hpp).
+template <class D>
+class ShortestPaths {
+public:
+    virtual ~ShortestPaths() {}
+
+    // Computes the distances from src to all other vertices
+    virtual void run(int src) = 0;
+
+    // Distance to v found by the last run(), dist_infinity<D>() if v is unreachable
+    virtual D distance(int v) const = 0;
+
+    // Distance from src to dst, infinite if dst is unreachable. Searches only
+    // until dst is settled, so afterwards distance() is only good for dst.
+    virtual D point_to_point(int src, int dst) = 0;
+
+    // Same answer as point_to_point(), found by searching from src and dst at
+    // once until the two searches meet. Leaves distance() undefined.
+    virtual D bidirectional(int src, int dst) = 0;
+
+    // Counters of every search since the engine was made
+    const SearchStats &stats() const { return counters; }
+
+protected:
+    SearchStats counters;
+};
+
+// Dijkstra's algorithm on any queue from queues.hpp (or one with the same
+// interface). The distance array and the queue are kept between runs; a
+// distance only counts when its stamp matches the current run's epoch, so a
+// new run starts in O(1) instead of refilling V distances with infinity.
+// Queue's keys are distances of type D.
+template <class Queue, class D>
+class DijkstraEngine : public ShortestPaths<D> {
+public:
+    DijkstraEngine(const CsrGraph &graph, int max_weight)
+        : graph(graph), max_weight(max_weight), pq(graph.num_vertices(), max_weight),
+          labels(graph.num_vertices(), Label{dist_infinity<D>(), 0}), epoch(0) {}
+
+    void run(int src) override {
+        search(src, -1);
+    }
+
+    D distance(int v) const override {
+        return labels[v].stamp == epoch ? labels[v].dist : dist_infinity<D>();
+    }
+
+    D point_to_point(int src, int dst) override {
+        search(src, dst);
+        return distance(dst);
+    }
+
+    D bidirectional(int src, int dst) override {
+        if (back_pq == nullptr) {
+            back_pq.reset(new Queue(graph.num_vertices(), max_weight));
+            back_labels.assign(graph.num_vertices(), Label{dist_infinity<D>(), 0});
+        }
+        next_epoch();
+        if (src == dst)
+            return 0;
+
+        Queue *queues[2] = {&pq, back_pq.get()};
+        Label *sides[2] = {labels.data(), back_labels.data()};
+        // Radius of each search: the distance it settled last
+        D radius[2] = {0, 0};
+        // Shortest src-dst path seen so far through an arc between the searches
+        D best = dist_infinity<D>();
+
+        for (int side = 0; side < 2; ++side) {
+            queues[side]->clear();
+            queues[side]->push(side == 0 ? src : dst, 0);
+            sides[side][side == 0 ? src : dst] = Label{0, epoch};
+        }
+
+        // The graph is undirected, so the search from dst walks the same arcs.
+        // Alternate between the sides until one runs out or no path shorter
+        // than best can still be found: any such path would need a vertex
+        // further than radius from both ends.
+        for (int side = 0; !pq.empty() && !back_pq->empty(); side ^= 1) {
+            Label *mine = sides[side];
+            const Label *other = sides[side ^ 1];
+            int u;
+            D du;
+            queues[side]->pop(u, du);
+            if (du != mine[u].dist)
+                continue;
+            radius[side] = du;
+            if (radius[0] >= best - radius[1])
+                break;
+
+            this->counters.relaxations += graph.end(u) - graph.begin(u);
+            for (const Arc *x = graph.begin(u); x != graph.end(u); ++x){
+                Label &v = mine[x->to];
+                D nd = dist_add(du, x->weight);
+                if (nd < (v.stamp == epoch ? v.dist : dist_infinity<D>()))
+                {
+                    v = Label{nd, epoch};
+                    queues[side]->push(x->to, nd);
+                }
+                if (other[x->to].stamp == epoch && other[x->to].dist < best - nd)
+                    best = nd + other[x->to].dist;
+            }
+        }
+        return best;
+    }
+
+private:
+    // Distance and the epoch it was written in, side by side so a
+    // relaxation touches one cache line
+    struct Label {
+        D dist;
+        uint32_t stamp;
+    };
+
+    const CsrGraph &graph;
+    int max_weight;
+    Queue pq;
+    std::vector<Label> labels;
+    // Queue and distances of the search from dst, made on first use
+    std::unique_ptr<Queue> back_pq;
+    std::vector<Label> back_labels;
+    uint32_t epoch;
+
+    // Starting a new epoch marks every distance as infinite
+    void next_epoch() {
+        if (++epoch == 0) {
+            for (Label &l : labels)
+                l.stamp = 0;
+            for (Label &l : back_labels)
+                l.stamp = 0;
+            epoch = 1;
+        }
+    }
+
+    // Dijkstra from src; stops once target is settled (never, when target is -1)
+    void search(int src, int target) {
+        next_epoch();
+
+        // Insert source itself in priority queue and initialize
+        // its distance as 0.
+        pq.clear();
+        pq.push(src, 0);
+        labels[src] = Label{0, epoch};
+
+        // Looping till priority queue becomes empty (or all
+        // distances are not finalized)
+        while (!pq.empty()){
+
+            // Extract the minimum distance vertex from the priority queue.
+            int u;
+            D du;
+            pq.pop(u, du);
+
+            // A stale entry: u was pushed again with a smaller distance
+            // and has already been settled with it.
+            if (du != labels[u].dist)
+                continue;
+
+            // Its distance is final now
+            if (u == target)
+                break;
+
+            // Get all adjacent of u.
+            this->counters.relaxations += graph.end(u) - graph.begin(u);
+            for (const Arc *x = graph.begin(u); x != graph.end(u); ++x){
+
+                // Get vertex label and the length of the path
+                // to it through u.
+                Label &v = labels[x->to];
+                D nd = dist_add(du, x->weight);
+
+                // If there is shorter path to v through u.
+                if (nd < (v.stamp == epoch ? v.dist : dist_infinity<D>()))
+                {
+                    // Updating distance of v
+                    v = Label{nd, epoch};
+                    pq.push(x->to, nd);
+                }
+            }
+        }
+    }
+};
+
+// Priority queues selectable at run time
+enum class QueueKind { Binary, Dary, Radix, Dial };
+
+// "binary", "dary", "radix" or "dial"
+inline bool parse_queue_kind(const char *name, QueueKind &kind){
+    static const struct { const char *name; QueueKind kind; } names[] = {
+        {"binary", QueueKind::Binary},
+        {"dary", QueueKind::Dary},
+        {"radix", QueueKind::Radix},
+        {"dial", QueueKind::Dial},
+    };
+    for (const auto &entry : names) {
+        if (strcmp(name, entry.name) == 0) {
+            kind = entry.kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Largest arc weight, which sizes Dial's bucket array
+inline int max_arc_weight(const CsrGraph &graph){
+    int w = 0;
+    for (int u = 0; u < graph.num_vertices(); ++u)
+        for (const Arc *x = graph.begin(u); x != graph.end(u); ++x)
+            if (x->weight > w)
+                w = x->weight;
+    return w;
+}
+
+// Radix heaps and Dial's buckets only take integer distances
+template <class D, bool integral = std::is_integral<D>::value>
+struct IntegerQueueEngines {
+    static ShortestPaths<D> *make(const CsrGraph &graph, QueueKind kind) {
+        if (kind == QueueKind::Radix)
+            return new DijkstraEngine<RadixHeap<D>, D>(graph, 0);
+        return new DijkstraEngine<DialQueue<D>, D>(graph, max_arc_weight(graph));
+    }
+};
+
+template <class D>
+struct IntegerQueueEngines<D, false> {
+    static ShortestPaths<D> *make(const CsrGraph &, QueueKind) { return nullptr; }
+};
+
+// Creates an engine running on the queue of the given kind, or returns null
+// for a radix or dial queue with floating-point distances
+template <class D>
+std::unique_ptr<ShortestPaths<D>> make_engine(const CsrGraph &graph, QueueKind kind){
+    switch (kind) {
+    case QueueKind::Dary:
+        return std::unique_ptr<ShortestPaths<D>>(new DijkstraEngine<IndexedDaryHeap<D, 4>, D>(graph, 0));
+    case QueueKind::Radix:
+    case QueueKind::Dial:
+        return std::unique_ptr<ShortestPaths<D>>(IntegerQueueEngines<D>::make(graph, kind));
+    case QueueKind::Binary:
+    default:
+        return std::unique_ptr<ShortestPaths<D>>(new DijkstraEngine<BinaryHeapQueue<D>, D>(graph, 0));
+    }
+}
+
+// Returns shortest distances from src to all other vertices
+template <class D = int>
+std::vector<D> dijkstra(const CsrGraph &graph, int src, QueueKind kind = QueueKind::Binary){
+    std::unique_ptr<ShortestPaths<D>> engine = make_engine<D>(graph, kind);
+    engine->run(src);
+    std::vector<D> dist(graph.num_vertices());
+    for (int v = 0; v < graph.num_vertices(); ++v)
+        dist[v] = engine->distance(v);
+    return dist;
+}
+
+#endif
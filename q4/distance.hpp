@@ -0,0 +1,65 @@
+#ifndef DISTANCE_HPP
+#define DISTANCE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+// Path lengths. The engines are templates over the distance type D, which
+// may be any signed integer type or a floating-point type; myDijkstra is
+// built for one of them with -DMYDIJKSTRA_DIST=<type> (the Makefile's DIST,
+// int by default, so the output keeps printing INT_MAX for unreachable).
+//
+// Infinity is the largest value of an integer type, or +inf. Adding an arc
+// weight saturates at infinity instead of overflowing, so a path too long to
+// represent reads as unreachable rather than as a negative distance.
+
+template <class D>
+inline D dist_infinity(){
+    return std::numeric_limits<D>::has_infinity ? std::numeric_limits<D>::infinity()
+                                                : std::numeric_limits<D>::max();
+}
+
+// d + w for a non-negative weight w, at most infinity. One add and a
+// conditional move for integers; floats saturate at +inf by themselves.
+template <class D>
+inline typename std::enable_if<std::is_integral<D>::value, D>::type dist_add(D d, int w){
+    D sum;
+    if (__builtin_add_overflow(d, (D)w, &sum))
+        return std::numeric_limits<D>::max();
+    return sum;
+}
+
+template <class D>
+inline typename std::enable_if<std::is_floating_point<D>::value, D>::type dist_add(D d, int w){
+    return d + (D)w;
+}
+
+// Appends the decimal text of d to out: integers exactly, floats with enough
+// digits to read back the same value
+template <class D>
+inline typename std::enable_if<std::is_integral<D>::value>::type append_dist(std::string &out, D d){
+    char digits[24];
+    int n = 0;
+    // Negate in unsigned arithmetic, so the most negative value works too
+    typename std::make_unsigned<D>::type v = d < 0 ? 0 - (typename std::make_unsigned<D>::type)d : d;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (d < 0)
+        out += '-';
+    while (n > 0)
+        out += digits[--n];
+}
+
+template <class D>
+inline typename std::enable_if<std::is_floating_point<D>::value>::type append_dist(std::string &out, D d){
+    char text[48];
+    snprintf(text, sizeof text, "%.*g", std::numeric_limits<D>::max_digits10, (double)d);
+    out += text;
+}
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef GRAPH_HPP
+#define GRAPH_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// One input edge {u, v, w}
+struct Edge {
+    int u;
+    int v;
+    int w;
+};
+
+// One outgoing arc of a vertex: its target and weight
+struct Arc {
+    int to;
+    int weight;
+};
+
+// Binary graph file: this header, then offsets as V + 1 uint64 values, then
+// the arcs as {int32 to, int32 weight} pairs, all in host byte order. With
+// csr_file_has_ranks a rank for every vertex follows as V uint32 values, and
+// with csr_file_has_core then the first rank of the core as one uint32. The
+// layout is CsrGraph's own, so a mapped file is used as it is.
+struct CsrFileHeader {
+    char magic[8];     // "Q4CSR" padded with NUL bytes
+    uint32_t version;  // csr_file_version
+    uint32_t flags;    // csr_file_has_ranks, csr_file_has_core or 0
+    uint64_t vertices;
+    uint64_t arcs;
+};
+
+static const char csr_file_magic[8] = {'Q', '4', 'C', 'S', 'R', 0, 0, 0};
+static const uint32_t csr_file_version = 1;
+
+// The file is the upward graph of a contraction hierarchy: it carries the
+// contraction rank of every vertex and every arc leads to a higher rank
+static const uint32_t csr_file_has_ranks = 1;
+
+// The hierarchy stopped contracting before the top: the vertices from the
+// core rank up were left as they were, and the arcs between them lead both ways
+static const uint32_t csr_file_has_core = 2;
+
+// core_rank() of a graph without a core
+static const uint32_t csr_no_core = UINT32_MAX;
+
+// Compressed sparse row graph: the arcs of vertex u are
+// arcs[offsets[u] .. offsets[u + 1]), all packed in one array,
+// so a relaxation loop walks contiguous memory with no per-edge allocation.
+// The arrays either live in the graph's own vectors or in an mmap'd binary
+// graph file, which the graph unmaps when it goes away.
+class CsrGraph {
+public:
+    CsrGraph()
+        : V(0), arc_count(0), offsets(nullptr), arcs(nullptr), ranks(nullptr), core(csr_no_core), map(nullptr),
+          map_size(0) {
+        own_offsets.assign(1, 0);
+        offsets = own_offsets.data();
+    }
+
+    // Move-only: a copy would have to duplicate or share the mapping
+    CsrGraph(const CsrGraph &) = delete;
+    CsrGraph &operator=(const CsrGraph &) = delete;
+    CsrGraph(CsrGraph &&other) noexcept : CsrGraph() { swap(other); }
+    CsrGraph &operator=(CsrGraph &&other) noexcept {
+        swap(other);
+        return *this;
+    }
+    ~CsrGraph() {
+        if (map != nullptr)
+            munmap(map, map_size);
+    }
+
+    // Directed graph: every edge {u, v, w} becomes the single arc u->v
+    static CsrGraph from_arcs(int V, const std::vector<Edge> &edges) {
+        CsrGraph g;
+        g.V = V;
+        g.own_offsets.assign(V + 1, 0);
+        for (const Edge &e : edges)
+            g.own_offsets[e.u + 1]++;
+        for (int u = 0; u < V; ++u)
+            g.own_offsets[u + 1] += g.own_offsets[u];
+        g.own_arcs.resize(g.own_offsets[V]);
+        std::vector<uint64_t> next(g.own_offsets.begin(), g.own_offsets.end() - 1);
+        for (const Edge &e : edges)
+            g.own_arcs[next[e.u]++] = {e.v, e.w};
+        g.offsets = g.own_offsets.data();
+        g.arcs = g.own_arcs.data();
+        g.arc_count = g.own_arcs.size();
+        return g;
+    }
+
+    // Undirected graph: every edge {u, v, w} becomes the arcs u->v and v->u
+    // (the same adjacency constructAdj used to build), in input order.
+    static CsrGraph from_edges(int V, const std::vector<Edge> &edges) {
+        CsrGraph g;
+        g.V = V;
+        g.own_offsets.assign(V + 1, 0);
+
+        // Count the degree of every vertex, then turn counts into offsets
+        for (const Edge &e : edges) {
+            g.own_offsets[e.u + 1]++;
+            g.own_offsets[e.v + 1]++;
+        }
+        for (int u = 0; u < V; ++u)
+            g.own_offsets[u + 1] += g.own_offsets[u];
+
+        // Place every arc at the next free slot of its source vertex
+        g.own_arcs.resize(g.own_offsets[V]);
+        std::vector<uint64_t> next(g.own_offsets.begin(), g.own_offsets.end() - 1);
+        for (const Edge &e : edges) {
+            g.own_arcs[next[e.u]++] = {e.v, e.w};
+            g.own_arcs[next[e.v]++] = {e.u, e.w};
+        }
+        g.offsets = g.own_offsets.data();
+        g.arcs = g.own_arcs.data();
+        g.arc_count = g.own_arcs.size();
+        return g;
+    }
+
+    // Writes the graph as a binary graph file. On failure returns false and
+    // describes the problem in error.
+    bool save(const char *path, std::string &error) const {
+        CsrFileHeader header;
+        memcpy(header.magic, csr_file_magic, sizeof header.magic);
+        header.version = csr_file_version;
+        header.flags = ranks != nullptr ? csr_file_has_ranks : 0;
+        if (ranks != nullptr && core != csr_no_core)
+            header.flags |= csr_file_has_core;
+        header.vertices = V;
+        header.arcs = arc_count;
+
+        FILE *f = fopen(path, "wb");
+        if (f == nullptr) {
+            error = std::string(path) + ": " + strerror(errno);
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+                  fwrite(offsets, sizeof(uint64_t), V + 1, f) == (size_t)V + 1 &&
+                  fwrite(arcs, sizeof(Arc), arc_count, f) == arc_count &&
+                  (ranks == nullptr || fwrite(ranks, sizeof(uint32_t), V, f) == (size_t)V) &&
+                  ((header.flags & csr_file_has_core) == 0 || fwrite(&core, sizeof core, 1, f) == 1);
+        if (fclose(f) != 0)
+            ok = false;
+        if (!ok)
+            error = std::string(path) + ": " + strerror(errno);
+        return ok;
+    }
+
+    // Maps a binary graph file written by save() and checks that it describes
+    // a valid graph. On failure returns false and describes the problem in error.
+    static bool load(const char *path, CsrGraph &graph, std::string &error) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            error = std::string(path) + ": " + strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            error = std::string(path) + ": " + strerror(errno);
+            close(fd);
+            return false;
+        }
+        size_t size = st.st_size;
+        if (size < sizeof(CsrFileHeader)) {
+            error = std::string(path) + ": not a graph file";
+            close(fd);
+            return false;
+        }
+        void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            error = std::string(path) + ": " + strerror(errno);
+            return false;
+        }
+
+        CsrGraph g;
+        g.map = map;
+        g.map_size = size;
+
+        const CsrFileHeader *header = static_cast<const CsrFileHeader *>(map);
+        if (memcmp(header->magic, csr_file_magic, sizeof header->magic) != 0) {
+            error = std::string(path) + ": not a graph file";
+            return false;
+        }
+        if (header->version != csr_file_version) {
+            error = std::string(path) + ": unsupported graph file version";
+            return false;
+        }
+        if ((header->flags & ~(csr_file_has_ranks | csr_file_has_core)) != 0 ||
+            header->flags == csr_file_has_core) {
+            error = std::string(path) + ": unsupported graph file flags";
+            return false;
+        }
+        bool has_ranks = (header->flags & csr_file_has_ranks) != 0;
+        bool has_core = (header->flags & csr_file_has_core) != 0;
+        uint64_t vertices = header->vertices, arc_count = header->arcs;
+        if (vertices == 0 || vertices > INT32_MAX || arc_count > (size / sizeof(Arc)) ||
+            size != sizeof(CsrFileHeader) + (vertices + 1) * sizeof(uint64_t) + arc_count * sizeof(Arc) +
+                    (has_ranks ? vertices * sizeof(uint32_t) : 0) + (has_core ? sizeof(uint32_t) : 0)) {
+            error = std::string(path) + ": truncated or corrupt graph file";
+            return false;
+        }
+        g.V = (int)vertices;
+        g.arc_count = arc_count;
+        g.offsets = reinterpret_cast<const uint64_t *>(header + 1);
+        g.arcs = reinterpret_cast<const Arc *>(g.offsets + vertices + 1);
+        if (has_ranks)
+            g.ranks = reinterpret_cast<const uint32_t *>(g.arcs + arc_count);
+        if (has_core)
+            memcpy(&g.core, g.ranks + vertices, sizeof g.core);
+
+        // One sequential pass so a bad file fails here rather than inside dijkstra()
+        madvise(map, size, MADV_SEQUENTIAL);
+        if (g.offsets[0] != 0 || g.offsets[vertices] != arc_count) {
+            error = std::string(path) + ": corrupt offsets";
+            return false;
+        }
+        for (uint64_t u = 0; u < vertices; ++u) {
+            if (g.offsets[u] > g.offsets[u + 1]) {
+                error = std::string(path) + ": corrupt offsets";
+                return false;
+            }
+        }
+        for (uint64_t i = 0; i < arc_count; ++i) {
+            if (g.arcs[i].to < 0 || (uint64_t)g.arcs[i].to >= vertices || g.arcs[i].weight < 0) {
+                error = std::string(path) + ": corrupt arc";
+                return false;
+            }
+        }
+        if (has_ranks) {
+            // A permutation of 0 .. V - 1, and arcs only lead upwards, except
+            // between two vertices of the core
+            if (has_core && g.core >= vertices) {
+                error = std::string(path) + ": corrupt ranks";
+                return false;
+            }
+            std::vector<bool> seen(vertices, false);
+            for (uint64_t u = 0; u < vertices; ++u) {
+                if (g.ranks[u] >= vertices || seen[g.ranks[u]]) {
+                    error = std::string(path) + ": corrupt ranks";
+                    return false;
+                }
+                seen[g.ranks[u]] = true;
+                for (const Arc *x = g.begin((int)u); x != g.end((int)u); ++x) {
+                    uint32_t from = g.ranks[u], to = g.ranks[x->to];
+                    if (to == from || (to < from && to < g.core)) {
+                        error = std::string(path) + ": corrupt ranks";
+                        return false;
+                    }
+                }
+            }
+        }
+
+        graph = std::move(g);
+        return true;
+    }
+
+    int num_vertices() const { return V; }
+    size_t num_arcs() const { return arc_count; }
+
+    // Contraction ranks, only present in a contraction hierarchy's upward
+    // graph, and the first rank of its core (csr_no_core if it has none)
+    bool has_ranks() const { return ranks != nullptr; }
+    uint32_t rank(int v) const { return ranks[v]; }
+    uint32_t core_rank() const { return core; }
+    void set_ranks(std::vector<uint32_t> r, uint32_t core_rank = csr_no_core) {
+        own_ranks.swap(r);
+        ranks = own_ranks.data();
+        core = core_rank;
+    }
+
+    // Range of the arcs leaving u
+    const Arc *begin(int u) const { return arcs + offsets[u]; }
+    const Arc *end(int u) const { return arcs + offsets[u + 1]; }
+
+private:
+    int V;
+    size_t arc_count;
+    const uint64_t *offsets;
+    const Arc *arcs;
+    const uint32_t *ranks;
+    uint32_t core;
+
+    // Storage when the graph was built in memory
+    std::vector<uint64_t> own_offsets;
+    std::vector<Arc> own_arcs;
+    std::vector<uint32_t> own_ranks;
+
+    // The mapped file when it was loaded
+    void *map;
+    size_t map_size;
+
+    // Moving a vector keeps its buffer, so the pointers stay valid
+    void swap(CsrGraph &other) noexcept {
+        std::swap(V, other.V);
+        std::swap(arc_count, other.arc_count);
+        std::swap(offsets, other.offsets);
+        std::swap(arcs, other.arcs);
+        std::swap(ranks, other.ranks);
+        std::swap(core, other.core);
+        own_offsets.swap(other.own_offsets);
+        own_arcs.swap(other.own_arcs);
+        own_ranks.swap(other.own_ranks);
+        std::swap(map, other.map);
+        std::swap(map_size, other.map_size);
+    }
+};
+
+#endif
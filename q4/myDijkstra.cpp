@@ -1,110 +1,458 @@
 #include <iostream>
 #include <vector>
-#include <queue>
 #include <climits>
+#include <cstdio>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "graph.hpp"
+#include "dijkstra.hpp"
+#include "delta_stepping.hpp"
+#include "ch.hpp"
 using namespace std;
 
-// Function to construct adjacency 
-vector<vector<vector<int>>> constructAdj(vector<vector<int>> 
-                             &edges, int V) {
-                                 
-    // adj[u] = list of {v, wt}
-    vector<vector<vector<int>>> adj(V); 
-
-    for (const auto &edge : edges) {
-        int u = edge[0];
-        int v = edge[1];
-        int wt = edge[2];
-        adj[u].push_back({v, wt});
-        adj[v].push_back({u, wt}); 
-    }
-    
-    return adj;}
-
-// Returns shortest distances from src to all other vertices
-vector<int> dijkstra(int V, vector<vector<int>> &edges, int src){
-    
-    // Create adjacency list
-    vector<vector<vector<int>>> adj = constructAdj(edges, V);
-
-    // Create a priority queue to store vertices that
-    // are being preprocessed.
-    priority_queue<vector<int>, vector<vector<int>>, 
-                   greater<vector<int>>> pq;
-
-    // Create a vector for distances and initialize all
-    // distances as infinite
-    vector<int> dist(V, INT_MAX);
-
-    // Insert source itself in priority queue and initialize
-    // its distance as 0.
-    pq.push({0, src});
-    dist[src] = 0;
-
-    // Looping till priority queue becomes empty (or all
-    // distances are not finalized) 
-    while (!pq.empty()){
-        
-        // The first vertex in pair is the minimum distance
-        // vertex, extract it from priority queue.
-        int u = pq.top()[1];
-        pq.pop();
-
-        // Get all adjacent of u.
-        for (auto x : adj[u]){
-            
-            // Get vertex label and weight of current
-            // adjacent of u.
-            int v = x[0];
-            int weight = x[1];
-
-            // If there is shorter path to v through u.
-            if (dist[v] > dist[u] + weight)
-            {
-                // Updating distance of v
-                dist[v] = dist[u] + weight;
-                pq.push({dist[v], v});
-            }
+// Distance type of every engine, chosen when building (see distance.hpp)
+#ifndef MYDIJKSTRA_DIST
+#define MYDIJKSTRA_DIST int
+#endif
+typedef MYDIJKSTRA_DIST Dist;
+
+// Reads stdin in large blocks and parses integers straight out of the
+// buffer, instead of one formatted cin extraction at a time.
+class TextReader {
+public:
+    TextReader() : buf(1 << 16), pos(0), len(0) {}
+
+    // Reads the next whitespace-separated integer. Fails at end of input, on
+    // anything that isn't a number and on numbers that don't fit in an int.
+    bool next_int(int &value) {
+        int c = get();
+        while (c == ' ' || c == '\n' || c == '\t' || c == '\r')
+            c = get();
+        bool negative = (c == '-');
+        if (c == '-' || c == '+')
+            c = get();
+        if (c < '0' || c > '9')
+            return false;
+        long long v = 0;
+        for (; c >= '0' && c <= '9'; c = get()) {
+            v = v * 10 + (c - '0');
+            if (v > (long long)INT_MAX + 1)
+                return false;
         }
+        if (c != EOF && c != ' ' && c != '\n' && c != '\t' && c != '\r')
+            return false;
+        v = negative ? -v : v;
+        if (v > INT_MAX)
+            return false;
+        value = (int)v;
+        return true;
     }
 
-    return dist;
-}
+private:
+    vector<char> buf;
+    size_t pos, len;
 
-// Driver program to test methods of graph class
-int main(){
-int V, E, src; 
-cin >> V >> E >> src;
+    int get() {
+        if (pos == len) {
+            len = fread(buf.data(), 1, buf.size(), stdin);
+            pos = 0;
+            if (len == 0)
+                return EOF;
+        }
+        return (unsigned char)buf[pos++];
+    }
+
+public:
+    // Input that was read into the buffer but not parsed yet
+    string rest() const { return string(buf.data() + pos, len - pos); }
+};
+
+// Reads "V E src" and then E edges "u v w" from stdin
+static bool read_text_graph(TextReader &in, CsrGraph &graph, int &src){
+int V, E;
 
-if (V <= 0 || E < 0 || src < 0 || src >= V) {
+if (!in.next_int(V) || !in.next_int(E) || !in.next_int(src) ||
+    V <= 0 || E < 0 || src < 0 || src >= V) {
     cerr << "Invalid input\n";
-    return 1;
+    return false;
 }
 
-vector<vector<int>> edges;
+vector<Edge> edges;
+edges.reserve(E);
 
 for (int i = 0; i < E; ++i) {
     int u, v, w;
-    cin >> u >> v >> w;
-
-    if (u < 0 || u >= V || v < 0 || v >= V) {
+    if (!in.next_int(u) || !in.next_int(v) || !in.next_int(w) ||
+        u < 0 || u >= V || v < 0 || v >= V) {
         cerr << "Invalid edge\n";
-        return 1;
+        return false;
     }
 
     if (w < 0) {
         cerr << "Negative weights not allowed in Dijkstra\n";
-        return 1;
+        return false;
     }
 
     edges.push_back({u, v, w});
 }
 
-    vector<int> result = dijkstra(V, edges, src);
+    // Pack the edges into a CSR graph once, then run on it directly
+    graph = CsrGraph::from_edges(V, edges);
+    return true;
+}
+
+static bool write_all(int fd, const char *data, size_t len){
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Answers query lines for --serve: "src" prints the distances from src to
+// every vertex on one line, "src dst" prints a single distance, found with a
+// search that stops at dst (or meets in the middle, with bidirectional). The
+// engine keeps the distances of the last full search, so queries from the
+// same source in a row only search once.
+class QueryServer {
+public:
+    QueryServer(ShortestPaths<Dist> &engine, int V, bool bidirectional)
+        : engine(engine), V(V), bidirectional(bidirectional), last_src(-1) {}
+
+    // Reads queries from in_fd until end of input and writes the answers to
+    // out_fd, flushing whenever the input runs dry. pending holds input that
+    // was already read. Returns false if the answers could not be written.
+    bool serve(int in_fd, int out_fd, string pending) {
+        vector<char> buf(1 << 16);
+        string out;
+        for (;;) {
+            size_t used = answer_lines(pending, false, out);
+            pending.erase(0, used);
+            if (!write_all(out_fd, out.data(), out.size()))
+                return false;
+            out.clear();
+
+            ssize_t n = read(in_fd, buf.data(), buf.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            pending.append(buf.data(), n);
+        }
+        // A last query without a newline
+        answer_lines(pending, true, out);
+        return write_all(out_fd, out.data(), out.size());
+    }
+
+private:
+    ShortestPaths<Dist> &engine;
+    int V;
+    bool bidirectional;
+    int last_src; // source of the last full search, -1 if engine holds none
+
+    // Answers every complete line of text (and the unterminated tail too when
+    // at_end), returning how many bytes were used
+    size_t answer_lines(const string &text, bool at_end, string &out) {
+        size_t start = 0;
+        for (;;) {
+            size_t newline = text.find('\n', start);
+            if (newline == string::npos) {
+                if (at_end && start < text.size()) {
+                    answer(text.substr(start), out);
+                    start = text.size();
+                }
+                return start;
+            }
+            answer(text.substr(start, newline - start), out);
+            start = newline + 1;
+        }
+    }
+
+    void answer(const string &line, string &out) {
+        long query[3];
+        int fields = 0;
+        const char *p = line.c_str();
+        for (;;) {
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+                ++p;
+            if (*p == '\0')
+                break;
+            char *end;
+            long v = strtol(p, &end, 10);
+            if (end == p || fields == 2 || v < 0 || v >= V || (*end != '\0' && !isspace((unsigned char)*end))) {
+                out += "Invalid query\n";
+                return;
+            }
+            query[fields++] = v;
+            p = end;
+        }
+        if (fields == 0)
+            return; // Blank line
+
+        int src = (int)query[0];
+        if (fields == 2 && src != last_src) {
+            int dst = (int)query[1];
+            last_src = -1;
+            append_dist(out, bidirectional ? engine.bidirectional(src, dst) : engine.point_to_point(src, dst));
+        } else if (fields == 2) {
+            append_dist(out, engine.distance((int)query[1]));
+        } else {
+            if (src != last_src) {
+                engine.run(src);
+                last_src = src;
+            }
+            for (int v = 0; v < V; ++v) {
+                append_dist(out, engine.distance(v));
+                out += ' ';
+            }
+        }
+        out += '\n';
+    }
+};
+
+// --listen: serves one client connection at a time on a Unix socket, for
+// as long as the server runs
+static int listen_queries(QueryServer &server, const char *path){
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof addr.sun_path) {
+        cerr << "Socket path too long\n";
+        close(fd);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) < 0 || listen(fd, 16) < 0) {
+        perror("bind");
+        close(fd);
+        return 1;
+    }
+
+    // A client that hangs up early must not take the server down with it
+    signal(SIGPIPE, SIG_IGN);
+    for (;;) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            close(fd);
+            return 1;
+        }
+        server.serve(client, client, string());
+        close(client);
+    }
+}
+
+static void usage(const char *prog){
+    cerr << "Usage: " << prog << " [--queue binary|dary|radix|dial]"
+         << " [--engine dijkstra|delta [--threads <n>] [--delta <width>]]"
+         << " [--graph <file> | --ch <file>] [--src <vertex>] [--dst <vertex> [--bidirectional]]"
+         << " [--convert <file> | --build-ch <file> | --serve | --listen <socket>]\n";
+}
+
+// Driver program to test methods of graph class
+int main(int argc, char *argv[]){
+    // --queue picks the priority queue dijkstra() runs on
+    QueueKind queue = QueueKind::Binary;
+    const char *graph_file = nullptr;
+    const char *convert_file = nullptr;
+    const char *src_text = nullptr;
+    const char *listen_path = nullptr;
+    const char *dst_text = nullptr;
+    const char *build_ch_file = nullptr;
+    bool ch_query = false; // graph_file is a contraction hierarchy from --build-ch
+    bool serve = false;
+    bool bidirectional = false;
+    // --engine delta: parallel delta-stepping instead of dijkstra()
+    bool delta_engine = false;
+    int threads = 0;
+    int delta = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--bidirectional") == 0) {
+            bidirectional = true;
+            continue;
+        }
+        const char *next = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (next == nullptr) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--queue") == 0) {
+            if (!parse_queue_kind(next, queue)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--graph") == 0) {
+            graph_file = next;
+            ch_query = false;
+        } else if (strcmp(argv[i], "--ch") == 0) {
+            graph_file = next;
+            ch_query = true;
+        } else if (strcmp(argv[i], "--build-ch") == 0) {
+            build_ch_file = next;
+        } else if (strcmp(argv[i], "--src") == 0) {
+            src_text = next;
+        } else if (strcmp(argv[i], "--engine") == 0) {
+            if (strcmp(next, "delta") != 0 && strcmp(next, "dijkstra") != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            delta_engine = strcmp(next, "delta") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(next);
+        } else if (strcmp(argv[i], "--delta") == 0) {
+            delta = atoi(next);
+        } else if (strcmp(argv[i], "--dst") == 0) {
+            dst_text = next;
+        } else if (strcmp(argv[i], "--convert") == 0) {
+            convert_file = next;
+        } else if (strcmp(argv[i], "--listen") == 0) {
+            listen_path = next;
+            serve = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        ++i;
+    }
+    // A graph file needs --src, except for serving, where the queries name the
+    // sources, and for building a hierarchy
+    if ((graph_file != nullptr && src_text == nullptr && !serve && build_ch_file == nullptr) ||
+        (graph_file == nullptr && src_text != nullptr) ||
+        (convert_file != nullptr && (graph_file != nullptr || serve || dst_text != nullptr)) ||
+        (serve && dst_text != nullptr) ||
+        (build_ch_file != nullptr && (ch_query || convert_file != nullptr || serve || dst_text != nullptr))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    CsrGraph graph;
+    int src = 0;
+    TextReader in;
+    if (graph_file != nullptr) {
+        // A binary graph file is mapped and used as it is
+        string error;
+        if (!CsrGraph::load(graph_file, graph, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        if (graph.has_ranks() != ch_query) {
+            cerr << graph_file << (ch_query ? ": not a contraction hierarchy, build one with --build-ch\n"
+                                            : ": holds a contraction hierarchy, load it with --ch\n");
+            return 1;
+        }
+        char *end;
+        long s = src_text != nullptr ? strtol(src_text, &end, 10) : 0;
+        if (src_text != nullptr && (*src_text == '\0' || *end != '\0' || s < 0 || s >= graph.num_vertices())) {
+            cerr << "Invalid input\n";
+            return 1;
+        }
+        src = (int)s;
+    } else if (!read_text_graph(in, graph, src)) {
+        return 1;
+    }
+
+    // --convert: store the text graph as a binary graph file for --graph
+    if (convert_file != nullptr) {
+        string error;
+        if (!graph.save(convert_file, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    // --build-ch: contract the graph and store the hierarchy for --ch
+    if (build_ch_file != nullptr) {
+        ChBuilder builder(graph);
+        CsrGraph upward = builder.build();
+        if (builder.overflowed()) {
+            cerr << "Path lengths too large for a contraction hierarchy\n";
+            return 1;
+        }
+        string error;
+        if (!upward.save(build_ch_file, error)) {
+            cerr << error << "\n";
+            return 1;
+        }
+        cerr << "contraction hierarchy: " << graph.num_vertices() << " vertices, "
+             << builder.num_shortcuts() << " shortcuts, " << builder.core_size() << " left in the core, "
+             << upward.num_arcs() << " upward arcs\n";
+        return 0;
+    }
+
+    if (!ch_query && !delta_engine && queue == QueueKind::Dial && max_arc_weight(graph) > DialQueue<int>::max_supported_weight) {
+        cerr << "Weights too large for the dial queue\n";
+        return 1;
+    }
+
+    // --serve / --listen: keep the graph and one engine, answer queries until
+    // the input ends. With a text graph on stdin the queries follow its edges.
+    unique_ptr<ShortestPaths<Dist>> engine;
+    if (ch_query)
+        engine.reset(new ChEngine<Dist>(graph));
+    else if (delta_engine)
+        engine.reset(new DeltaSteppingEngine<Dist>(graph, threads, delta));
+    else
+        engine = make_engine<Dist>(graph, queue);
+    if (engine == nullptr) {
+        cerr << "The radix and dial queues need integer distances\n";
+        return 1;
+    }
+
+    if (serve) {
+        QueryServer server(*engine, graph.num_vertices(), bidirectional);
+        if (listen_path != nullptr)
+            return listen_queries(server, listen_path);
+        return server.serve(STDIN_FILENO, STDOUT_FILENO, in.rest()) ? 0 : 1;
+    }
+
+    // --dst: only the distance from src to dst
+    if (dst_text != nullptr) {
+        char *end;
+        long dst = strtol(dst_text, &end, 10);
+        if (*dst_text == '\0' || *end != '\0' || dst < 0 || dst >= graph.num_vertices()) {
+            cerr << "Invalid input\n";
+            return 1;
+        }
+        string out;
+        append_dist(out, bidirectional ? engine->bidirectional(src, (int)dst) : engine->point_to_point(src, (int)dst));
+        out += '\n';
+        return write_all(STDOUT_FILENO, out.data(), out.size()) ? 0 : 1;
+    }
+
+    engine->run(src);
 
     // Print shortest distances in one line
-    for (int dist : result)
-        cout << dist << " ";
- 
-    return 0;
+    string out;
+    for (int v = 0; v < graph.num_vertices(); ++v) {
+        append_dist(out, engine->distance(v));
+        out += ' ';
+    }
+    return write_all(STDOUT_FILENO, out.data(), out.size()) ? 0 : 1;
 }
@@ -0,0 +1,246 @@
+#ifndef QUEUES_HPP
+#define QUEUES_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Priority queues for dijkstra(). All of them store vertices by key with the
+// same interface:
+//   push(v, key)  queue v with key, or lower its key if it is already queued
+//   pop(v, key)   remove a vertex with the smallest key
+//   empty()
+//   clear()       drop everything, keeping the allocated memory
+//
+// The lazy queues (binary, radix, dial) implement push by inserting another
+// entry, so pop may return a stale pair whose key is above the vertex's final
+// distance; dijkstra() recognises and skips those. The indexed heap keeps one
+// entry per vertex and never returns stale pairs.
+
+// std::priority_queue of (key, vertex) pairs with duplicate pushes
+template <class Key>
+class BinaryHeapQueue {
+public:
+    BinaryHeapQueue(int /*V*/, Key /*max_weight*/) {}
+
+    void push(int v, Key key) { heap.push({key, v}); }
+    void pop(int &v, Key &key) {
+        key = heap.top().first;
+        v = heap.top().second;
+        heap.pop();
+    }
+    bool empty() const { return heap.empty(); }
+    void clear() {
+        while (!heap.empty())
+            heap.pop();
+    }
+
+private:
+    std::priority_queue<std::pair<Key, int>, std::vector<std::pair<Key, int>>,
+                        std::greater<std::pair<Key, int>>> heap;
+};
+
+// Indexed D-ary heap with decrease-key. pos[v] is v's slot in the heap; it is
+// only trusted when vert[pos[v]] == v, so the array never needs resetting.
+// A 4-ary heap is shallower than a binary one and its children share a cache line.
+template <class Key, int D = 4>
+class IndexedDaryHeap {
+public:
+    IndexedDaryHeap(int V, Key /*max_weight*/) : pos(V, 0), count(0) {}
+
+    void push(int v, Key key) {
+        size_t p = pos[v];
+        if (p < count && vert[p] == v) {
+            if (key < keys[p]) {
+                keys[p] = key;
+                sift_up(p);
+            }
+            return;
+        }
+        if (count == vert.size()) {
+            vert.push_back(v);
+            keys.push_back(key);
+        } else {
+            vert[count] = v;
+            keys[count] = key;
+        }
+        pos[v] = count;
+        sift_up(count++);
+    }
+
+    void pop(int &v, Key &key) {
+        v = vert[0];
+        key = keys[0];
+        --count;
+        if (count > 0) {
+            vert[0] = vert[count];
+            keys[0] = keys[count];
+            pos[vert[0]] = 0;
+            sift_down(0);
+        }
+    }
+
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+
+private:
+    std::vector<size_t> pos;
+    std::vector<int> vert;
+    std::vector<Key> keys;
+    size_t count;
+
+    void place(size_t i, int v, Key key) {
+        vert[i] = v;
+        keys[i] = key;
+        pos[v] = i;
+    }
+
+    void sift_up(size_t i) {
+        int v = vert[i];
+        Key key = keys[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / D;
+            if (!(key < keys[parent]))
+                break;
+            place(i, vert[parent], keys[parent]);
+            i = parent;
+        }
+        place(i, v, key);
+    }
+
+    void sift_down(size_t i) {
+        int v = vert[i];
+        Key key = keys[i];
+        for (;;) {
+            size_t first = D * i + 1;
+            if (first >= count)
+                break;
+            size_t last = first + D < count ? first + D : count;
+            size_t best = first;
+            for (size_t c = first + 1; c < last; ++c)
+                if (keys[c] < keys[best])
+                    best = c;
+            if (!(keys[best] < key))
+                break;
+            place(i, vert[best], keys[best]);
+            i = best;
+        }
+        place(i, v, key);
+    }
+};
+
+// Radix heap for monotone integer keys (every pushed key >= the last popped
+// one, which Dijkstra guarantees). Bucket b > 0 holds keys whose highest bit
+// differing from the last popped key is bit b - 1; refilling bucket 0 from
+// the lowest non-empty bucket moves each entry O(log C) times in total.
+template <class Key>
+class RadixHeap {
+    static_assert(std::is_integral<Key>::value, "radix heap needs integer keys");
+    typedef typename std::make_unsigned<Key>::type UKey;
+    static const int bits = sizeof(Key) * 8;
+
+public:
+    RadixHeap(int /*V*/, Key /*max_weight*/) : last(0), count(0) {}
+
+    void push(int v, Key key) {
+        buckets[bucket_of((UKey)key)].push_back({(UKey)key, v});
+        ++count;
+    }
+
+    void pop(int &v, Key &key) {
+        if (buckets[0].empty()) {
+            int b = 1;
+            while (buckets[b].empty())
+                ++b;
+            // The new minimum becomes the reference point; everything in
+            // bucket b now differs from it in a lower bit
+            UKey lowest = buckets[b][0].first;
+            for (const auto &entry : buckets[b])
+                if (entry.first < lowest)
+                    lowest = entry.first;
+            last = lowest;
+            for (const auto &entry : buckets[b])
+                buckets[bucket_of(entry.first)].push_back(entry);
+            buckets[b].clear();
+        }
+        key = (Key)buckets[0].back().first;
+        v = buckets[0].back().second;
+        buckets[0].pop_back();
+        --count;
+    }
+
+    bool empty() const { return count == 0; }
+    void clear() {
+        for (auto &bucket : buckets)
+            bucket.clear();
+        last = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<std::pair<UKey, int>> buckets[bits + 1];
+    UKey last;
+    size_t count;
+
+    int bucket_of(UKey key) const {
+        UKey diff = key ^ last;
+        if (diff == 0)
+            return 0;
+        int b = 0;
+        while (diff != 0) {
+            diff >>= 1;
+            ++b;
+        }
+        return b;
+    }
+};
+
+// Dial's bucket queue for small integer weights: live keys always lie in
+// [current, current + max_weight], so max_weight + 1 circular buckets hold one
+// key each and pop just walks forward to the next non-empty bucket.
+template <class Key>
+class DialQueue {
+    static_assert(std::is_integral<Key>::value, "Dial's queue needs integer keys");
+
+public:
+    DialQueue(int /*V*/, Key max_weight)
+        : buckets((size_t)max_weight + 1), current(0), count(0) {}
+
+    void push(int v, Key key) {
+        buckets[(size_t)key % buckets.size()].push_back(v);
+        ++count;
+    }
+
+    void pop(int &v, Key &key) {
+        while (buckets[(size_t)current % buckets.size()].empty())
+            ++current;
+        std::vector<int> &bucket = buckets[(size_t)current % buckets.size()];
+        v = bucket.back();
+        bucket.pop_back();
+        key = current;
+        --count;
+    }
+
+    bool empty() const { return count == 0; }
+    void clear() {
+        if (count > 0)
+            for (auto &bucket : buckets)
+                bucket.clear();
+        current = 0;
+        count = 0;
+    }
+
+    // Biggest weight the queue accepts without an unreasonable bucket array
+    static const long long max_supported_weight = 1 << 24;
+
+private:
+    std::vector<std::vector<int>> buckets;
+    Key current;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * Benchmark for the maxSubarraySum implementations
+ *
+ * Times maxSubarraySum itself, in-process, instead of the whole program
+ * under -pg: the maxSubarraySum of the three maxSubArrayN.cpp programs (linked
+ * in as maxN_maxSubarraySum, see the makefile) next to the library's
+ * maxsubarray_find ("max4"). Every (algorithm, N) point gets
+ * warm-up calls, then repeated timed calls on the same generateInput(N, seed)
+ * array, and is reported as one CSV row:
+ *
+ *   algorithm,n,runs,median_s,p99_s,min_s,cycles,instructions,cache_misses
+ *
+ * The counter columns are the median per call, from perf_event_open (user
+ * space only), and are empty when --counters is off or the kernel refuses.
+ * --format markdown prints the median times as the N x algorithm table of
+ * results_profiling.txt instead.
+ *
+ * A point whose single call is predicted (from the previous N and the
+ * algorithm's complexity) to take longer than --budget seconds is skipped, and
+ * no point spends more than the budget on repeats, so the O(n^3) version
+ * doesn't hold up the sweep.
+ */
+
+#include <bits/stdc++.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "maxsubarray.hpp"
+
+using namespace std;
+
+// From maxSubArray1-3.cpp, renamed when compiled for the benchmark
+int max1_maxSubarraySum(vector<int> &arr);
+int max2_maxSubarraySum(vector<int> &arr);
+int max3_maxSubarraySum(const vector<int> &arr);
+vector<int> max1_generateInput(int N, int seed);
+
+static long long run_max1(vector<int>& arr){ return max1_maxSubarraySum(arr); }
+static long long run_max2(vector<int>& arr){ return max2_maxSubarraySum(arr); }
+static long long run_max3(vector<int>& arr){ return max3_maxSubarraySum(arr); }
+static long long run_max4(vector<int>& arr){
+    maxsubarray_options options = {1, 0};
+    return maxsubarray_find(arr.data(), arr.size(), options).sum;
+}
+
+static const struct {
+    const char* name;
+    long long (*run)(vector<int>& arr);
+    int exponent; // time grows as N^exponent
+} algorithms[] = {
+    {"max1", run_max1, 1},
+    {"max2", run_max2, 2},
+    {"max3", run_max3, 3},
+    {"max4", run_max4, 1},
+};
+
+// Cycles, instructions and cache misses of this thread, as one group
+struct perf_group {
+    int fd[3];
+    bool open;
+};
+
+static bool perf_group_open(perf_group* group){
+    static const unsigned long long configs[3] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES};
+    group->open = false;
+    for (int k = 0; k < 3; k++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[k];
+        attr.disabled = k == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        int leader = k == 0 ? -1 : group->fd[0];
+        group->fd[k] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (group->fd[k] < 0) {
+            perror("perf_event_open");
+            for (int j = 0; j < k; j++) {
+                close(group->fd[j]);
+            }
+            return false;
+        }
+    }
+    group->open = true;
+    return true;
+}
+
+static void perf_group_start(const perf_group& group){
+    ioctl(group.fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group.fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static bool perf_group_stop(const perf_group& group, unsigned long long out[3]){
+    ioctl(group.fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    unsigned long long values[4]; // nr, then one value per event
+    if (read(group.fd[0], values, sizeof(values)) != (ssize_t)sizeof(values)) {
+        return false;
+    }
+    for (int k = 0; k < 3; k++) {
+        out[k] = values[k + 1];
+    }
+    return true;
+}
+
+template <class T>
+static T median(vector<T> v){
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (T)((v[n / 2 - 1] + v[n / 2]) / 2);
+}
+
+// Nearest-rank percentile
+static double percentile(vector<double> v, double p){
+    sort(v.begin(), v.end());
+    size_t rank = (size_t)ceil(p / 100 * v.size());
+    return v[max<size_t>(rank, 1) - 1];
+}
+
+template <class T>
+static vector<T> parse_list(const char* text, bool (*parse)(const string&, T*)){
+    vector<T> items;
+    string s(text);
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == string::npos) {
+            comma = s.size();
+        }
+        T item;
+        if (!parse(s.substr(start, comma - start), &item)) {
+            fprintf(stderr, "Invalid list item in '%s'\n", text);
+            exit(1);
+        }
+        items.push_back(item);
+        start = comma + 1;
+    }
+    return items;
+}
+
+static bool parse_positive(const string& s, int* v){
+    char* end;
+    long n = strtol(s.c_str(), &end, 10);
+    *v = (int)n;
+    return !s.empty() && *end == '\0' && n > 0 && n <= INT_MAX;
+}
+
+static bool parse_name(const string& s, string* v){
+    *v = s;
+    return !s.empty();
+}
+
+static double seconds_since(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+struct point {
+    string algorithm;
+    int n;
+    int runs;
+    double median_s, p99_s, min_s;
+    bool counted;
+    unsigned long long counters[3];
+};
+
+static void print_csv(const vector<point>& points){
+    printf("algorithm,n,runs,median_s,p99_s,min_s,cycles,instructions,cache_misses\n");
+    for (const point& p : points) {
+        printf("%s,%d,%d,%.9f,%.9f,%.9f,", p.algorithm.c_str(), p.n, p.runs, p.median_s, p.p99_s, p.min_s);
+        if (p.counted) {
+            printf("%llu,%llu,%llu\n", p.counters[0], p.counters[1], p.counters[2]);
+        } else {
+            printf(",,\n");
+        }
+    }
+}
+
+// One row per N, one column per algorithm; skipped points are "-"
+static void print_markdown(const vector<point>& points, const vector<int>& sizes, const vector<string>& names){
+    printf("| N \\ median seconds |");
+    for (const string& name : names) {
+        printf(" %s |", name.c_str());
+    }
+    printf("\n|---|");
+    for (size_t k = 0; k < names.size(); k++) {
+        printf("---|");
+    }
+    printf("\n");
+    for (int n : sizes) {
+        printf("| %d |", n);
+        for (const string& name : names) {
+            const point* found = nullptr;
+            for (const point& p : points) {
+                if (p.algorithm == name && p.n == n) {
+                    found = &p;
+                }
+            }
+            if (found != nullptr) {
+                printf(" %.6g |", found->median_s);
+            } else {
+                printf(" - |");
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]){
+    vector<int> sizes = parse_list<int>("100,1000,10000", parse_positive);
+    vector<string> names = parse_list<string>("max1,max2,max3,max4", parse_name);
+    int runs = 21;
+    int warmup = 3;
+    int seed = 42;
+    double budget = 10;
+    bool counters = false;
+    bool markdown = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+            continue;
+        }
+        const char* next = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (next == nullptr) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--sizes") == 0) {
+            sizes = parse_list<int>(next, parse_positive);
+        } else if (strcmp(argv[i], "--algorithms") == 0) {
+            names = parse_list<string>(next, parse_name);
+        } else if (strcmp(argv[i], "--runs") == 0) {
+            runs = max(1, atoi(next));
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            warmup = max(0, atoi(next));
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = atoi(next);
+        } else if (strcmp(argv[i], "--budget") == 0) {
+            budget = atof(next);
+        } else if (strcmp(argv[i], "--format") == 0 && (strcmp(next, "csv") == 0 || strcmp(next, "markdown") == 0)) {
+            markdown = strcmp(next, "markdown") == 0;
+        } else {
+            fprintf(stderr, "Usage: %s [--sizes N,...] [--algorithms max1,max2,max3,max4] [--runs R]"
+                            " [--warmup W] [--seed S] [--budget seconds] [--counters] [--format csv|markdown]\n",
+                    argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    sort(sizes.begin(), sizes.end());
+
+    perf_group group = {{-1, -1, -1}, false};
+    if (counters && !perf_group_open(&group)) {
+        fprintf(stderr, "Hardware counters unavailable, reporting times only\n");
+    }
+
+    vector<point> points;
+    volatile long long sink = 0; // keeps the calls from being optimized away
+    for (const string& name : names) {
+        size_t a = 0;
+        while (a < sizeof(algorithms) / sizeof(algorithms[0]) && name != algorithms[a].name) {
+            a++;
+        }
+        if (a == sizeof(algorithms) / sizeof(algorithms[0])) {
+            fprintf(stderr, "Unknown algorithm %s\n", name.c_str());
+            return 1;
+        }
+
+        int last_n = 0;
+        double last_median = 0;
+        for (int n : sizes) {
+            if (last_n > 0 && last_median * pow((double)n / last_n, algorithms[a].exponent) > budget) {
+                fprintf(stderr, "Skipping %s at N = %d: over the %g s budget\n", name.c_str(), n, budget);
+                continue;
+            }
+            vector<int> arr = max1_generateInput(n, seed);
+            auto started = chrono::steady_clock::now();
+            for (int w = 0; w < warmup && seconds_since(started) < budget; w++) {
+                sink = sink + algorithms[a].run(arr);
+            }
+
+            vector<double> times;
+            vector<unsigned long long> counts[3];
+            started = chrono::steady_clock::now();
+            while ((int)times.size() < runs && (times.empty() || seconds_since(started) < budget)) {
+                if (group.open) {
+                    perf_group_start(group);
+                }
+                auto start = chrono::steady_clock::now();
+                sink = sink + algorithms[a].run(arr);
+                times.push_back(seconds_since(start));
+                unsigned long long values[3];
+                if (group.open && perf_group_stop(group, values)) {
+                    for (int k = 0; k < 3; k++) {
+                        counts[k].push_back(values[k]);
+                    }
+                }
+            }
+
+            point p;
+            p.algorithm = name;
+            p.n = n;
+            p.runs = (int)times.size();
+            p.median_s = median(times);
+            p.p99_s = percentile(times, 99);
+            p.min_s = *min_element(times.begin(), times.end());
+            p.counted = counts[0].size() == times.size();
+            for (int k = 0; k < 3; k++) {
+                p.counters[k] = p.counted ? median(counts[k]) : 0;
+            }
+            points.push_back(p);
+            last_n = n;
+            last_median = p.median_s;
+        }
+    }
+
+    if (markdown) {
+        print_markdown(points, sizes, names);
+    } else {
+        print_csv(points);
+    }
+    return 0;
+}
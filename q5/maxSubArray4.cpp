@@ -0,0 +1,164 @@
+// C++ Program for Maximum Subarray Sum using the parallel Kadane library
+// complexity: O(n / threads + threads)
+// Each thread summarizes one chunk as (total, best prefix, best suffix, best)
+// and the summaries are merged in O(1) each, see maxsubarray.hpp
+//
+// With --stream the values are read instead of generated: raw native-endian
+// int32 from a file (mapped a window at a time) or from stdin ("-"), in
+// O(1) memory, so the input may be far larger than RAM.
+
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "maxsubarray.hpp"
+using namespace std;
+
+// Bytes mapped (or read) at a time; a multiple of the page size and of 4
+static const size_t stream_window = (size_t)64 << 20;
+
+// Generate input array of N random integers in range [-25, 74]
+vector<int> generateInput(int N, int seed) {
+    srand(seed);
+    vector<int> arr(N);
+    for (int i = 0; i < N; ++i) {
+        arr[i] = rand() % 100 - 25; // [0, 99] -> [-25, 74]
+    }
+    return arr;
+}
+
+static void printResult(const char* label, const maxsubarray_result& result, ostream& out) {
+    out << label << result.sum << " [" << result.first << ", " << result.last << "]" << endl;
+}
+
+static void feed(maxsubarray_stream& stream, const int* data, size_t n, bool progress) {
+    maxsubarray_stream_feed(stream, data, n);
+    if (progress && stream.count > 0) {
+        cerr << stream.count << " values, ";
+        printResult("best so far:", stream.summary.best, cerr);
+    }
+}
+
+// Maps the file window by window; each window is unmapped before the next one
+// so the pages can be dropped as soon as they are read
+static bool streamFile(int fd, maxsubarray_stream& stream, bool progress) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size % sizeof(int) != 0) {
+        cerr << "Error: input size is not a multiple of " << sizeof(int) << " bytes." << endl;
+        return false;
+    }
+    for (size_t pos = 0; pos < size; pos += stream_window) {
+        size_t len = min(stream_window, size - pos);
+        void* map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, (off_t)pos);
+        if (map == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        madvise(map, len, MADV_SEQUENTIAL);
+        feed(stream, static_cast<const int*>(map), len / sizeof(int), progress);
+        munmap(map, len);
+    }
+    return true;
+}
+
+// Pipes can't be mapped: read into one window-sized buffer, carrying a
+// value split across two reads over to the next one
+static bool streamPipe(int fd, maxsubarray_stream& stream, bool progress) {
+    vector<int> buffer(stream_window / sizeof(int));
+    char* bytes = reinterpret_cast<char*>(buffer.data());
+    size_t held = 0;
+    for (;;) {
+        ssize_t n = read(fd, bytes + held, stream_window - held);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            perror("read");
+            return false;
+        }
+        held += (size_t)n;
+        if (n == 0 || held == stream_window) {
+            size_t whole = held / sizeof(int);
+            feed(stream, buffer.data(), whole, progress);
+            memmove(bytes, bytes + whole * sizeof(int), held % sizeof(int));
+            held %= sizeof(int);
+        }
+        if (n == 0) {
+            break;
+        }
+    }
+    if (held != 0) {
+        cerr << "Error: input ends inside a value." << endl;
+        return false;
+    }
+    return true;
+}
+
+static int streamMain(const char* path, bool progress) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    maxsubarray_stream stream;
+    maxsubarray_stream_init(stream);
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    bool ok = regular ? streamFile(fd, stream, progress) : streamPipe(fd, stream, progress);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    if (!ok) {
+        return 1;
+    }
+    if (stream.count == 0) {
+        cerr << "Error: no values in input." << endl;
+        return 1;
+    }
+    printResult("Max4:", stream.summary.best, cout);
+    return 0;
+}
+
+static int usage(const char* prog) {
+    cerr << "Usage: " << prog << " <seed> <N> [threads]" << endl;
+    cerr << "       " << prog << " --stream <file|-> [--progress]" << endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--stream") == 0) {
+        bool progress = argc == 4 && strcmp(argv[3], "--progress") == 0;
+        if (argc != 3 && !progress) {
+            return usage(argv[0]);
+        }
+        return streamMain(argv[2], progress);
+    }
+    if (argc != 3 && argc != 4) {
+        return usage(argv[0]);
+    }
+
+    int seed = atoi(argv[1]);
+    int N = atoi(argv[2]);
+    int threads = argc == 4 ? atoi(argv[3]) : 0;
+
+    if (N <= 0) {
+        cerr << "Error: N must be positive." << endl;
+        return 1;
+    }
+
+    // Generate input array
+    vector<int> arr = generateInput(N, seed);
+
+    // Calculate the maximum subarray sum and where it is
+    maxsubarray_options options = {threads, 0};
+    maxsubarray_result result = maxsubarray_find(arr.data(), arr.size(), options);
+    printResult("Max4:", result, cout);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+// C++ Program for the Maximum Sum Rectangle in a matrix, using the library
+// complexity: O(min(R, C)^2 * max(R, C) / threads)
+// Every band of rows from a fixed top row keeps running column sums, and
+// Kadane over the sums finds the best rectangle of that band, see maxsubarray.hpp
+
+#include <bits/stdc++.h>
+#include "maxsubarray.hpp"
+using namespace std;
+
+// Generate a R x C row-major matrix of random integers in range [-25, 74]
+vector<int> generateInput(int R, int C, int seed) {
+    srand(seed);
+    vector<int> matrix((size_t)R * C);
+    for (size_t i = 0; i < matrix.size(); ++i) {
+        matrix[i] = rand() % 100 - 25; // [0, 99] -> [-25, 74]
+    }
+    return matrix;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4 && argc != 5) {
+        cerr << "Usage: " << argv[0] << " <seed> <rows> <cols> [threads]" << endl;
+        return 1;
+    }
+
+    int seed = atoi(argv[1]);
+    int R = atoi(argv[2]);
+    int C = atoi(argv[3]);
+    int threads = argc == 5 ? atoi(argv[4]) : 0;
+
+    if (R <= 0 || C <= 0) {
+        cerr << "Error: rows and cols must be positive." << endl;
+        return 1;
+    }
+
+    // Generate input matrix
+    vector<int> matrix = generateInput(R, C, seed);
+
+    // Calculate the maximum sum rectangle and where it is
+    maxsubarray_options options = {threads, 0};
+    maxsubarray_rect result = maxsubarray_find_2d(matrix.data(), R, C, options);
+    cout << "Max5:" << result.sum << " rows [" << result.top << ", " << result.bottom << "] cols ["
+         << result.left << ", " << result.right << "]" << endl;
+
+    return 0;
+}
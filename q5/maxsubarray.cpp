@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "maxsubarray.hpp"
+#include "maxsubarray_kernel.hpp"
+using namespace std;
+
+static bool earlier(const maxsubarray_result& a, const maxsubarray_result& b){
+    return a.first < b.first || (a.first == b.first && a.last < b.last);
+}
+
+// Better of two candidates under the tie-breaking of maxsubarray_result
+static const maxsubarray_result& better(const maxsubarray_result& a, const maxsubarray_result& b){
+    if (a.sum != b.sum) {
+        return a.sum > b.sum ? a : b;
+    }
+    return earlier(a, b) ? a : b;
+}
+
+maxsubarray_summary maxsubarray_merge(const maxsubarray_summary& left, const maxsubarray_summary& right){
+    maxsubarray_summary s;
+    s.total = left.total + right.total;
+
+    // Ties keep the shorter prefix, which ends in left
+    long long through = left.total + right.prefix;
+    if (through > left.prefix) {
+        s.prefix = through;
+        s.prefix_last = right.prefix_last;
+    } else {
+        s.prefix = left.prefix;
+        s.prefix_last = left.prefix_last;
+    }
+
+    // and the longer suffix, which starts in left
+    through = left.suffix + right.total;
+    if (through >= right.suffix) {
+        s.suffix = through;
+        s.suffix_first = left.suffix_first;
+    } else {
+        s.suffix = right.suffix;
+        s.suffix_first = right.suffix_first;
+    }
+
+    maxsubarray_result crossing = {left.suffix + right.prefix, left.suffix_first, right.prefix_last};
+    s.best = better(better(left.best, crossing), right.best);
+    return s;
+}
+
+maxsubarray_summary maxsubarray_kernel_scalar(const int* data, size_t n, size_t offset){
+    return scalar_summary(data, n, offset);
+}
+
+maxsubarray_rect maxsubarray_band_scalar(const int* matrix, size_t rows, size_t cols, size_t top,
+                                         bool transposed, long long* colsum){
+    return band_kernel<1>(matrix, rows, cols, top, transposed, colsum);
+}
+
+namespace {
+
+struct kernel_entry {
+    const char* name;
+    maxsubarray_kernel_fn fn;
+    maxsubarray_band_fn band;
+    bool (*supported)();
+};
+
+bool always_supported() { return true; }
+
+#if defined(__x86_64__) || defined(__i386__)
+bool has_avx512() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"); }
+bool has_avx2() { return __builtin_cpu_supports("avx2"); }
+#endif
+
+// Fastest first: the first supported entry is the default kernel
+const kernel_entry kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+    {"avx512", maxsubarray_kernel_avx512, maxsubarray_band_avx512, has_avx512},
+    {"avx2", maxsubarray_kernel_avx2, maxsubarray_band_avx2, has_avx2},
+#endif
+    {"scalar", maxsubarray_kernel_scalar, maxsubarray_band_scalar, always_supported},
+};
+
+const size_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+// Scalar until select_kernel() below picks one for the CPU, in case another
+// static initializer calls into the library first
+const kernel_entry* active_kernel = &kernels[kernel_count - 1];
+
+const kernel_entry* find_kernel(const char* name){
+    for (size_t k = 0; k < kernel_count; k++) {
+        if (strcmp(kernels[k].name, name) == 0) {
+            return kernels[k].supported() ? &kernels[k] : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// Runs at program start. MAXSUBARRAY_KERNEL=<name> overrides the choice.
+__attribute__((constructor)) void select_kernel(){
+    const char* forced = getenv("MAXSUBARRAY_KERNEL");
+    if (forced != nullptr && maxsubarray_set_kernel(forced)) {
+        return;
+    }
+    for (size_t k = 0; k < kernel_count; k++) {
+        if (kernels[k].supported()) {
+            active_kernel = &kernels[k];
+            return;
+        }
+    }
+}
+
+} // namespace
+
+const char* maxsubarray_kernel_name(){
+    return active_kernel->name;
+}
+
+bool maxsubarray_set_kernel(const char* name){
+    const kernel_entry* kernel = find_kernel(name);
+    if (kernel == nullptr) {
+        return false;
+    }
+    active_kernel = kernel;
+    return true;
+}
+
+maxsubarray_summary maxsubarray_summarize(const int* data, size_t n, size_t offset){
+    return active_kernel->fn(data, n, offset);
+}
+
+maxsubarray_result maxsubarray_find(const int* data, size_t n, const maxsubarray_options& options){
+    size_t min_chunk = options.min_chunk > 0 ? options.min_chunk : (size_t)1 << 16;
+    int threads = options.threads > 0 ? options.threads : (int)thread::hardware_concurrency();
+    threads = (int)max<size_t>(1, min<size_t>(max(threads, 1), n / min_chunk));
+
+    // Chunk c is data[c * n / threads .. (c + 1) * n / threads)
+    vector<maxsubarray_summary> parts(threads);
+    auto summarize_chunk = [&](int c) {
+        size_t begin = n / threads * c + n % threads * c / threads;
+        size_t end = n / threads * (c + 1) + n % threads * (c + 1) / threads;
+        parts[c] = maxsubarray_summarize(data + begin, end - begin, begin);
+    };
+    vector<thread> workers;
+    for (int c = 1; c < threads; c++) {
+        workers.emplace_back(summarize_chunk, c);
+    }
+    summarize_chunk(0);
+    for (thread& t : workers) {
+        t.join();
+    }
+
+    maxsubarray_summary s = parts[0];
+    for (int c = 1; c < threads; c++) {
+        s = maxsubarray_merge(s, parts[c]);
+    }
+    return s.best;
+}
+
+maxsubarray_result maxsubarray_find(const int* data, size_t n){
+    return maxsubarray_summarize(data, n, 0).best;
+}
+
+// out = the cols x rows transpose of in, in 32 x 32 tiles so that both sides
+// stay in cache
+static void transpose(const int* in, size_t rows, size_t cols, int* out){
+    const size_t tile = 32;
+    for (size_t r0 = 0; r0 < rows; r0 += tile) {
+        for (size_t c0 = 0; c0 < cols; c0 += tile) {
+            size_t r1 = min(rows, r0 + tile), c1 = min(cols, c0 + tile);
+            for (size_t r = r0; r < r1; r++) {
+                for (size_t c = c0; c < c1; c++) {
+                    out[c * rows + r] = in[r * cols + c];
+                }
+            }
+        }
+    }
+}
+
+maxsubarray_rect maxsubarray_find_2d(const int* matrix, size_t rows, size_t cols,
+                                     const maxsubarray_options& options){
+    bool transposed = rows > cols;
+    vector<int> flipped;
+    if (transposed) {
+        flipped.resize(rows * cols);
+        transpose(matrix, rows, cols, flipped.data());
+        matrix = flipped.data();
+        swap(rows, cols);
+    }
+
+    int threads = options.threads > 0 ? options.threads : (int)thread::hardware_concurrency();
+    threads = (int)max<size_t>(1, min<size_t>(max(threads, 1), rows));
+
+    // Bands starting near the top are the longest, so they go out first
+    atomic<size_t> next_top(0);
+    vector<maxsubarray_rect> best(threads);
+    maxsubarray_band_fn band = active_kernel->band;
+    auto work = [&](int t) {
+        vector<long long> colsum(cols);
+        bool found = false;
+        for (size_t top = next_top++; top < rows; top = next_top++) {
+            maxsubarray_rect rect = band(matrix, rows, cols, top, transposed, colsum.data());
+            if (!found || maxsubarray_rect_better(rect, best[t])) {
+                best[t] = rect;
+                found = true;
+            }
+        }
+        if (!found) {
+            best[t] = maxsubarray_rect{LLONG_MIN, 0, 0, 0, 0};
+        }
+    };
+    vector<thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (thread& w : workers) {
+        w.join();
+    }
+
+    maxsubarray_rect result = best[0];
+    for (int t = 1; t < threads; t++) {
+        if (maxsubarray_rect_better(best[t], result)) {
+            result = best[t];
+        }
+    }
+    return result;
+}
+
+void maxsubarray_stream_init(maxsubarray_stream& stream){
+    stream.summary = maxsubarray_summary();
+    stream.count = 0;
+}
+
+void maxsubarray_stream_feed(maxsubarray_stream& stream, const int* data, size_t n){
+    if (n == 0) {
+        return;
+    }
+    maxsubarray_summary piece = maxsubarray_summarize(data, n, stream.count);
+    stream.summary = stream.count == 0 ? piece : maxsubarray_merge(stream.summary, piece);
+    stream.count += n;
+}
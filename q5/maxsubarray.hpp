@@ -0,0 +1,93 @@
+#ifndef MAXSUBARRAY_HPP
+#define MAXSUBARRAY_HPP
+
+#include <cstddef>
+
+// The non-empty subarray data[first..last] (both inclusive) with the largest
+// sum. Among subarrays with equal sums it is the one that starts first, then
+// the shorter one, so every function below agrees on the indices.
+struct maxsubarray_result {
+    long long sum;
+    size_t first;
+    size_t last;
+};
+
+// What a segment data[begin..end) contributes to any array it is part of.
+// Indices are absolute (they include the segment's offset). The prefix is
+// the shortest best one, the suffix the longest best one, so that merging
+// keeps the tie-breaking of maxsubarray_result.
+struct maxsubarray_summary {
+    long long total;
+    long long prefix;    // best data[begin..prefix_last]
+    size_t prefix_last;
+    long long suffix;    // best data[suffix_first..end)
+    size_t suffix_first;
+    maxsubarray_result best;
+};
+
+// Summary of the n > 0 values data[0..n); offset is the index of data[0] in
+// the whole array
+maxsubarray_summary maxsubarray_summarize(const int* data, size_t n, size_t offset);
+
+// Summary of left followed directly by right, in O(1)
+maxsubarray_summary maxsubarray_merge(const maxsubarray_summary& left, const maxsubarray_summary& right);
+
+struct maxsubarray_options {
+    int threads;       // worker threads, the caller's included (0: one per hardware thread)
+    size_t min_chunk;  // smallest chunk worth a thread (0: 1 << 16 values)
+};
+
+// Kadane over data[0..n), n > 0: the array is cut into one chunk per thread,
+// every chunk is summarized in parallel and the summaries are merged left to
+// right. Sums are long long, so they don't overflow for any realistic n.
+maxsubarray_result maxsubarray_find(const int* data, size_t n, const maxsubarray_options& options);
+
+// Single-threaded; same result
+maxsubarray_result maxsubarray_find(const int* data, size_t n);
+
+// The rectangle matrix[top..bottom][left..right] (all inclusive) with the
+// largest sum. Ties go to the smaller (top, bottom, left, right).
+struct maxsubarray_rect {
+    long long sum;
+    size_t top;
+    size_t bottom;
+    size_t left;
+    size_t right;
+};
+
+// Maximum-sum rectangle of the rows x cols row-major matrix (both > 0), in
+// O(min(rows, cols)^2 * max(rows, cols)). A matrix with more rows than
+// columns is transposed first, so the quadratic dimension is the short one.
+// Every band of rows starting at one top row is a unit of work, handed to the
+// threads from a shared counter; the band keeps running column sums, adds
+// each further row to them and runs the chunk kernel over the sums.
+// options.min_chunk is not used.
+maxsubarray_rect maxsubarray_find_2d(const int* matrix, size_t rows, size_t cols,
+                                     const maxsubarray_options& options);
+
+// Kadane over values that arrive in pieces (a pipe, or a file too large to
+// hold in memory), in O(1) memory: every piece is summarized and merged into
+// the summary of everything before it. After any feed, summary.best is the
+// best subarray of the count values seen so far, with indices counted from
+// the first value; it is only meaningful once count > 0.
+struct maxsubarray_stream {
+    maxsubarray_summary summary;
+    unsigned long long count;
+};
+
+void maxsubarray_stream_init(maxsubarray_stream& stream);
+
+// Appends data[0..n) to the stream; n may be 0
+void maxsubarray_stream_feed(maxsubarray_stream& stream, const int* data, size_t n);
+
+// The chunk kernel is picked at program start: avx512 or avx2 (several scans
+// side by side in vector registers) if the CPU supports them, else scalar.
+// The MAXSUBARRAY_KERNEL environment variable overrides the choice. All
+// kernels give identical results.
+const char* maxsubarray_kernel_name();
+
+// Switches kernel at runtime (e.g. for benchmarking). Returns false, keeping
+// the current kernel, if the name is unknown or the CPU lacks support for it.
+bool maxsubarray_set_kernel(const char* name);
+
+#endif
@@ -0,0 +1,18 @@
+#include "maxsubarray_kernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifndef __AVX2__
+#error "maxsubarray_avx2.cpp must be compiled with -mavx2"
+#endif
+
+maxsubarray_summary maxsubarray_kernel_avx2(const int* data, size_t n, size_t offset){
+    return lane_kernel<8>(data, n, offset);
+}
+
+maxsubarray_rect maxsubarray_band_avx2(const int* matrix, size_t rows, size_t cols, size_t top,
+                                       bool transposed, long long* colsum){
+    return band_kernel<16>(matrix, rows, cols, top, transposed, colsum);
+}
+
+#endif
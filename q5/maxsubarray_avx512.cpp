@@ -0,0 +1,20 @@
+#include "maxsubarray_kernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#if !defined(__AVX512F__) || !defined(__AVX512VL__)
+#error "maxsubarray_avx512.cpp must be compiled with -mavx512f -mavx512vl"
+#endif
+
+// Twice the lanes of the AVX2 kernel: a 512-bit register holds 8 of the
+// 64-bit sums, and two independent vectors hide the latency of each other
+maxsubarray_summary maxsubarray_kernel_avx512(const int* data, size_t n, size_t offset){
+    return lane_kernel<16>(data, n, offset);
+}
+
+maxsubarray_rect maxsubarray_band_avx512(const int* matrix, size_t rows, size_t cols, size_t top,
+                                         bool transposed, long long* colsum){
+    return band_kernel<32>(matrix, rows, cols, top, transposed, colsum);
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef MAXSUBARRAY_KERNEL_HPP
+#define MAXSUBARRAY_KERNEL_HPP
+
+#include "maxsubarray.hpp"
+
+// Internal to libmaxsubarray.a: the kernels behind maxsubarray_summarize()
+// and maxsubarray_find_2d().
+//
+// A chunk kernel returns the summary of the n > 0 values data[0..n), like
+// maxsubarray_summarize(). A band kernel finds the best rectangle whose top
+// row is top, over every bottom row, in a rows x cols row-major matrix;
+// colsum is scratch space for cols sums. When transposed, the matrix is the
+// transpose of the caller's and the rectangle is reported (and ties are
+// broken) in the caller's coordinates.
+
+typedef maxsubarray_summary (*maxsubarray_kernel_fn)(const int* data, size_t n, size_t offset);
+typedef maxsubarray_rect (*maxsubarray_band_fn)(const int* matrix, size_t rows, size_t cols, size_t top,
+                                                bool transposed, long long* colsum);
+
+// One Kadane scan. Always available, and used for the tail of every lane kernel
+maxsubarray_summary maxsubarray_kernel_scalar(const int* data, size_t n, size_t offset);
+maxsubarray_rect maxsubarray_band_scalar(const int* matrix, size_t rows, size_t cols, size_t top,
+                                         bool transposed, long long* colsum);
+
+#if defined(__x86_64__) || defined(__i386__)
+maxsubarray_summary maxsubarray_kernel_avx2(const int* data, size_t n, size_t offset);
+maxsubarray_rect maxsubarray_band_avx2(const int* matrix, size_t rows, size_t cols, size_t top,
+                                       bool transposed, long long* colsum);
+maxsubarray_summary maxsubarray_kernel_avx512(const int* data, size_t n, size_t offset);
+maxsubarray_rect maxsubarray_band_avx512(const int* matrix, size_t rows, size_t cols, size_t top,
+                                         bool transposed, long long* colsum);
+#endif
+
+// Below this many values per lane the plain scan is as fast
+const size_t maxsubarray_lane_min_length = 64;
+
+// Larger sum first, then the smaller (top, bottom, left, right)
+inline bool maxsubarray_rect_better(const maxsubarray_rect& a, const maxsubarray_rect& b)
+{
+    if (a.sum != b.sum) {
+        return a.sum > b.sum;
+    }
+    if (a.top != b.top) {
+        return a.top < b.top;
+    }
+    if (a.bottom != b.bottom) {
+        return a.bottom < b.bottom;
+    }
+    if (a.left != b.left) {
+        return a.left < b.left;
+    }
+    return a.right < b.right;
+}
+
+namespace {
+
+// maxsubarray_avx2.cpp and maxsubarray_avx512.cpp each instantiate these
+// templates with their own -m flags. Internal linkage keeps every object on
+// its own instantiation: were they shared, the linker could keep the AVX-512
+// one and the scalar path would fault on CPUs without it. T is int for arrays
+// and long long for the column sums of the 2D search.
+
+template <class T>
+inline maxsubarray_summary scalar_summary(const T* data, size_t n, size_t offset)
+{
+    long long run = 0, total = 0;
+    size_t run_first = 0;
+    long long best = data[0], prefix = data[0];
+    size_t best_first = 0, best_last = 0, prefix_last = 0;
+    // The best suffix starts after the smallest prefix sum total(data[0..i))
+    long long low = 0;
+    size_t low_first = 0;
+    for (size_t i = 0; i < n; i++) {
+        long long x = data[i];
+        bool lower = total < low;
+        low = lower ? total : low;
+        low_first = lower ? i : low_first;
+
+        // Extend the run ending at i - 1 unless it is negative; ties extend,
+        // keeping the earlier start
+        bool extend = run >= 0 && i > 0;
+        run = extend ? run + x : x;
+        run_first = extend ? run_first : i;
+        bool improved = run > best;
+        best = improved ? run : best;
+        best_first = improved ? run_first : best_first;
+        best_last = improved ? i : best_last;
+
+        total += x;
+        bool longer = total > prefix;
+        prefix = longer ? total : prefix;
+        prefix_last = longer ? i : prefix_last;
+    }
+    maxsubarray_summary s;
+    s.total = total;
+    s.prefix = prefix;
+    s.prefix_last = offset + prefix_last;
+    s.suffix = total - low;
+    s.suffix_first = offset + low_first;
+    s.best.sum = best;
+    s.best.first = offset + best_first;
+    s.best.last = offset + best_last;
+    return s;
+}
+
+// L independent Kadane scans run in lockstep, each over its own contiguous
+// slice of m values, and the slices are merged at the end. A single scan is
+// one long chain of dependent max() operations; independent lanes keep the
+// pipeline busy, and with the lane state in arrays and a loop body free of
+// branches (on random data every comparison in it is a coin toss) GCC turns
+// the inner loop into vector code at -O3.
+template <int L, class T>
+inline maxsubarray_summary lane_summary(const T* data, size_t m, size_t offset)
+{
+    long long run[L], total[L], best[L], prefix[L], low[L];
+    size_t run_first[L], best_first[L], best_last[L], prefix_last[L], low_first[L];
+    for (int k = 0; k < L; k++) {
+        long long x = data[k * m];
+        run[k] = x;
+        total[k] = x;
+        best[k] = x;
+        prefix[k] = x;
+        low[k] = 0;
+        run_first[k] = best_first[k] = best_last[k] = prefix_last[k] = low_first[k] = 0;
+    }
+    for (size_t i = 1; i < m; i++) {
+        for (int k = 0; k < L; k++) {
+            long long x = data[k * m + i];
+            bool lower = total[k] < low[k];
+            low[k] = lower ? total[k] : low[k];
+            low_first[k] = lower ? i : low_first[k];
+
+            bool extend = run[k] >= 0;
+            run[k] = extend ? run[k] + x : x;
+            run_first[k] = extend ? run_first[k] : i;
+            bool improved = run[k] > best[k];
+            best[k] = improved ? run[k] : best[k];
+            best_first[k] = improved ? run_first[k] : best_first[k];
+            best_last[k] = improved ? i : best_last[k];
+
+            total[k] += x;
+            bool longer = total[k] > prefix[k];
+            prefix[k] = longer ? total[k] : prefix[k];
+            prefix_last[k] = longer ? i : prefix_last[k];
+        }
+    }
+
+    maxsubarray_summary s;
+    for (int k = 0; k < L; k++) {
+        size_t base = offset + k * m;
+        maxsubarray_summary lane;
+        lane.total = total[k];
+        lane.prefix = prefix[k];
+        lane.prefix_last = base + prefix_last[k];
+        lane.suffix = total[k] - low[k];
+        lane.suffix_first = base + low_first[k];
+        lane.best.sum = best[k];
+        lane.best.first = base + best_first[k];
+        lane.best.last = base + best_last[k];
+        s = k == 0 ? lane : maxsubarray_merge(s, lane);
+    }
+    return s;
+}
+
+// L = 1 is the single scan
+template <int L, class T>
+inline maxsubarray_summary lane_kernel(const T* data, size_t n, size_t offset)
+{
+    size_t m = n / L;
+    if (L == 1 || m < maxsubarray_lane_min_length) {
+        return scalar_summary(data, n, offset);
+    }
+    maxsubarray_summary s = lane_summary<L>(data, m, offset);
+    size_t done = m * L;
+    if (done < n) {
+        s = maxsubarray_merge(s, scalar_summary(data + done, n - done, offset + done));
+    }
+    return s;
+}
+
+// Adds every row from top down to colsum in turn, a plain loop that
+// vectorizes, and runs the L-lane kernel over the sums after each row: the
+// best subarray of colsum is the best rectangle spanning rows top..bottom.
+// The SIMD band kernels use twice the lanes of their chunk kernel (16 for
+// AVX2, 32 for AVX-512): the sums are long long either way, and in
+// maxsubarray_find_2d on one thread over a random 512 x 4096 matrix that ran
+// about 9% faster than the chunk kernel's own lane count.
+template <int L>
+inline maxsubarray_rect band_kernel(const int* matrix, size_t rows, size_t cols, size_t top,
+                                    bool transposed, long long* colsum)
+{
+    for (size_t c = 0; c < cols; c++) {
+        colsum[c] = 0;
+    }
+    maxsubarray_rect best = {0, 0, 0, 0, 0};
+    for (size_t bottom = top; bottom < rows; bottom++) {
+        const int* row = matrix + bottom * cols;
+        for (size_t c = 0; c < cols; c++) {
+            colsum[c] += row[c];
+        }
+        maxsubarray_result r = lane_kernel<L>(colsum, cols, 0).best;
+        maxsubarray_rect rect;
+        rect.sum = r.sum;
+        if (transposed) {
+            rect.top = r.first, rect.bottom = r.last, rect.left = top, rect.right = bottom;
+        } else {
+            rect.top = top, rect.bottom = bottom, rect.left = r.first, rect.right = r.last;
+        }
+        if (bottom == top || maxsubarray_rect_better(rect, best)) {
+            best = rect;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,556 @@
+/*
+ * Benchmark for the signal_sender/signal_receiver transports
+ *
+ * For every transport, a receiver and a sender are forked; a pipe replaces
+ * the PID prompt (the receiver writes a byte once it is ready, and the
+ * sender is given its PID). Both sides run the code the two programs ship:
+ * the senders of signal_send.hpp, and for rt, signalfd and shm the receive
+ * loops of signal_receive.hpp, with a handler that takes a timestamp where
+ * signal_receiver prints. The legacy receiver is signal_receiver's handler,
+ * which exits after one byte there, kept counting here.
+ *
+ * Transports:
+ * - legacy   - SIGUSR1/SIGUSR2 bits with send_bit()'s 100ms delay, one byte
+ *              per message, received in a sigaction handler
+ * - rt       - the --rt protocol, received with sigtimedwait()
+ * - signalfd - the --rt protocol, received by a signalfd in an epoll loop
+ * - shm      - the --shm ring
+ *
+ * Two phases per transport, over one connection:
+ * - Latency: --messages messages of --size bytes, one after the other. The
+ *   sender writes the time before each message into memory shared by both
+ *   processes, the receiver the time it has the whole message; the difference
+ *   is the one-way latency (CLOCK_MONOTONIC is the same for all processes).
+ * - Bandwidth: --bw-bytes in messages of --bw-size bytes, from the start of
+ *   the first message to the receiver having the last. For legacy, whose
+ *   messages are single bytes, it is measured over the latency phase.
+ *
+ * One CSV row per transport on stdout:
+ *
+ *   transport,sender_cpu,receiver_cpu,messages,size,mean_us,p50_us,p99_us,max_us,bw_bytes,bytes_per_s
+ *
+ * --cpus S,R pins the sender to CPU S and the receiver to CPU R (equal for
+ * same-core runs); -1 in the columns means not pinned. --histogram FILE writes
+ * the latency histograms, in power-of-two microsecond buckets, as
+ *
+ *   transport,low_us,high_us,count
+ */
+
+#include <iostream>
+#include <fstream>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include "rt_protocol.hpp"
+#include "shm_ring.hpp"
+#include "signal_receive.hpp"
+#include "signal_send.hpp"
+
+struct Options
+{
+    std::vector<std::string> transports;
+    int messages;      // latency phase (legacy: bytes)
+    size_t size;       // bytes per latency message
+    size_t bw_bytes;   // bandwidth phase total
+    size_t bw_size;    // bytes per bandwidth message
+    int legacy_bytes;  // latency messages for legacy, 800ms each
+    int sender_cpu;    // -1: not pinned
+    int receiver_cpu;
+    std::string histogram;
+
+    Options()
+        : transports({"legacy", "rt", "signalfd", "shm"}), messages(1000), size(64), bw_bytes(4u << 20),
+          bw_size(64u << 10), legacy_bytes(2), sender_cpu(-1), receiver_cpu(-1)
+    {
+    }
+};
+
+/*
+ * Per-transport plan, and the timestamps both children write into a
+ * MAP_SHARED mapping set up before the fork
+ */
+struct Run
+{
+    int latency_messages;
+    size_t latency_size;
+    int bw_messages;
+    size_t bw_size;
+    int64_t *sent_ns;  // written by the sender before message i
+    int64_t *recv_ns;  // written by the receiver once it has message i
+
+    int total() const { return latency_messages + bw_messages; }
+    size_t size_of(int i) const { return i < latency_messages ? latency_size : bw_size; }
+};
+
+int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void pin_to(int cpu)
+{
+    if (cpu < 0)
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+    {
+        perror("sched_setaffinity");
+        _exit(1);
+    }
+}
+
+// The receiver's "My PID is": one byte on the pipe once it can take signals
+void announce_ready(int fd)
+{
+    char ready = 1;
+    if (write(fd, &ready, 1) != 1)
+    {
+        _exit(1);
+    }
+    close(fd);
+}
+
+// ===== Receivers =====
+
+// legacy: the handler of signal_receiver.cpp, timestamping every 8th bit
+volatile sig_atomic_t legacy_bits = 0;
+volatile sig_atomic_t legacy_received = 0;
+int64_t *legacy_recv_ns = nullptr;
+
+void handle_legacy(int sig)
+{
+    (void)sig;
+    if (++legacy_bits == 8)
+    {
+        legacy_recv_ns[legacy_received] = now_ns(); // clock_gettime() is async-signal-safe
+        legacy_bits = 0;
+        ++legacy_received;
+    }
+}
+
+void receive_legacy(const Run &run, int ready_fd)
+{
+    legacy_recv_ns = run.recv_ns;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_legacy;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGUSR1);
+    sigaddset(&sa.sa_mask, SIGUSR2);
+    sigaction(SIGUSR1, &sa, nullptr);
+    sigaction(SIGUSR2, &sa, nullptr);
+
+    // Blocked between the check and sigsuspend(), so the last bit can't slip
+    // in between and leave the loop waiting forever
+    sigset_t blocked, waiting;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGUSR1);
+    sigaddset(&blocked, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &blocked, &waiting);
+    announce_ready(ready_fd);
+    while (legacy_received < run.total())
+    {
+        sigsuspend(&waiting);
+    }
+}
+
+// rt, signalfd, shm: the loops of signal_receive.hpp, timestamping each
+// message and stopping after the last one
+class TimingHandler : public ReceiveHandler
+{
+public:
+    TimingHandler(const Run &run, int ready_fd) : run(run), ready_fd(ready_fd), received(0) {}
+
+    void ready() override
+    {
+        announce_ready(ready_fd);
+    }
+
+    bool message(pid_t, const std::string &) override
+    {
+        run.recv_ns[received++] = now_ns();
+        return received < run.total();
+    }
+
+    bool number(pid_t, int) override
+    {
+        return true;
+    }
+
+    // The benchmark is gone
+    bool keep_going() override
+    {
+        return kill(getppid(), 0) == 0;
+    }
+
+private:
+    const Run &run;
+    int ready_fd;
+    int received;
+};
+
+// ===== Senders =====
+
+void send_all(const std::string &transport, const Run &run, pid_t receiver)
+{
+    if (transport == "legacy")
+    {
+        for (int i = 0; i < run.total(); ++i)
+        {
+            run.sent_ns[i] = now_ns();
+            for (int b = 7; b >= 0; --b)
+            {
+                send_bit(receiver, ((i & 0xff) >> b) & 1);
+            }
+        }
+        return;
+    }
+
+    ShmRing ring;
+    if (transport == "shm")
+    {
+        pid_t none = 0;
+        if (!shm_ring_open(ring, receiver) || !ring.header->producer_pid.compare_exchange_strong(none, getpid()))
+        {
+            std::cerr << "Cannot open the ring of " << receiver << std::endl;
+            _exit(1);
+        }
+    }
+    else
+    {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, rt_ack_signal());
+        sigprocmask(SIG_BLOCK, &set, nullptr);
+    }
+
+    std::string message;
+    for (int i = 0; i < run.total(); ++i)
+    {
+        if (message.size() != run.size_of(i))
+        {
+            message.assign(run.size_of(i), 'x');
+        }
+        run.sent_ns[i] = now_ns();
+        bool ok = transport == "shm" ? send_message_shm(ring, message) : send_message_rt(receiver, message);
+        if (!ok)
+        {
+            _exit(1);
+        }
+    }
+    if (transport == "shm")
+    {
+        ring.header->producer_pid.store(0);
+        shm_ring_close(ring, false);
+    }
+}
+
+// ===== Driver =====
+
+/*
+ * Forks the receiver, waits for it to be ready, forks the sender and waits
+ * for both. Returns false if either failed.
+ */
+bool run_transport(const std::string &transport, const Run &run, const Options &options)
+{
+    int ready[2];
+    if (pipe(ready) == -1)
+    {
+        perror("pipe");
+        return false;
+    }
+
+    pid_t receiver = fork();
+    if (receiver == 0)
+    {
+        close(ready[0]);
+        pin_to(options.receiver_cpu);
+        if (transport == "legacy")
+        {
+            receive_legacy(run, ready[1]);
+            _exit(0);
+        }
+        TimingHandler handler(run, ready[1]);
+        int rc;
+        if (transport == "rt")
+        {
+            rc = receive_rt(handler);
+        }
+        else if (transport == "signalfd")
+        {
+            rc = receive_signalfd(handler);
+        }
+        else
+        {
+            rc = receive_shm(handler);
+        }
+        _exit(rc);
+    }
+    close(ready[1]);
+    char byte;
+    bool up = receiver > 0 && read(ready[0], &byte, 1) == 1;
+    close(ready[0]);
+    if (!up)
+    {
+        std::cerr << transport << ": receiver failed to start" << std::endl;
+        if (receiver > 0)
+        {
+            waitpid(receiver, nullptr, 0);
+        }
+        return false;
+    }
+
+    pid_t sender_pid = fork();
+    if (sender_pid == 0)
+    {
+        pin_to(options.sender_cpu);
+        send_all(transport, run, receiver);
+        _exit(0);
+    }
+
+    int status = 1;
+    if (sender_pid > 0)
+    {
+        waitpid(sender_pid, &status, 0);
+    }
+    bool ok = sender_pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!ok)
+    {
+        kill(receiver, SIGKILL);
+    }
+    waitpid(receiver, &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!ok)
+    {
+        std::cerr << transport << ": failed" << std::endl;
+    }
+    return ok;
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = list.size();
+        }
+        if (comma > start)
+        {
+            items.push_back(list.substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+    return items;
+}
+
+void usage(const char *program)
+{
+    std::cerr << "Usage: " << program
+              << " [--transports legacy,rt,signalfd,shm] [--messages N] [--size BYTES]\n"
+                 "       [--bw-bytes BYTES] [--bw-size BYTES] [--legacy-bytes N] [--cpus SENDER,RECEIVER]\n"
+                 "       [--histogram FILE]"
+              << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--transports")
+        {
+            options.transports = split(value);
+        }
+        else if (arg == "--messages")
+        {
+            options.messages = atoi(value.c_str());
+        }
+        else if (arg == "--size")
+        {
+            options.size = strtoul(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "--bw-bytes")
+        {
+            options.bw_bytes = strtoul(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "--bw-size")
+        {
+            options.bw_size = strtoul(value.c_str(), nullptr, 10);
+        }
+        else if (arg == "--legacy-bytes")
+        {
+            options.legacy_bytes = atoi(value.c_str());
+        }
+        else if (arg == "--cpus")
+        {
+            std::vector<std::string> cpus = split(value);
+            if (cpus.size() != 2)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            options.sender_cpu = atoi(cpus[0].c_str());
+            options.receiver_cpu = atoi(cpus[1].c_str());
+        }
+        else if (arg == "--histogram")
+        {
+            options.histogram = value;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    for (size_t t = 0; t < options.transports.size(); ++t)
+    {
+        const std::string &name = options.transports[t];
+        if (name != "legacy" && name != "rt" && name != "signalfd" && name != "shm")
+        {
+            std::cerr << "Unknown transport: " << name << std::endl;
+            return 1;
+        }
+    }
+    if (options.messages <= 0 || options.legacy_bytes <= 0 || options.bw_size == 0 ||
+        options.size > RT_MAX_LENGTH || options.bw_size > RT_MAX_LENGTH)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ofstream histogram;
+    if (!options.histogram.empty())
+    {
+        histogram.open(options.histogram.c_str());
+        if (!histogram)
+        {
+            std::cerr << "Cannot write " << options.histogram << std::endl;
+            return 1;
+        }
+        histogram << "transport,low_us,high_us,count\n";
+    }
+
+    std::cout << "transport,sender_cpu,receiver_cpu,messages,size,mean_us,p50_us,p99_us,max_us,bw_bytes,bytes_per_s"
+              << std::endl;
+    bool all_ok = true;
+    for (size_t t = 0; t < options.transports.size(); ++t)
+    {
+        const std::string &transport = options.transports[t];
+        bool legacy = transport == "legacy";
+
+        Run run;
+        run.latency_messages = legacy ? options.legacy_bytes : options.messages;
+        run.latency_size = legacy ? 1 : options.size;
+        run.bw_size = options.bw_size;
+        run.bw_messages = legacy ? 0 : (int)((options.bw_bytes + options.bw_size - 1) / options.bw_size);
+
+        size_t stamps = 2 * (size_t)run.total() * sizeof(int64_t);
+        void *shared = mmap(nullptr, stamps, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared == MAP_FAILED)
+        {
+            perror("mmap");
+            return 1;
+        }
+        run.sent_ns = static_cast<int64_t *>(shared);
+        run.recv_ns = run.sent_ns + run.total();
+
+        if (!run_transport(transport, run, options))
+        {
+            munmap(shared, stamps);
+            all_ok = false;
+            continue;
+        }
+
+        std::vector<double> latency_us(run.latency_messages);
+        double sum = 0;
+        for (int i = 0; i < run.latency_messages; ++i)
+        {
+            latency_us[i] = (run.recv_ns[i] - run.sent_ns[i]) / 1e3;
+            sum += latency_us[i];
+        }
+        std::sort(latency_us.begin(), latency_us.end());
+
+        int first = legacy ? 0 : run.latency_messages;
+        size_t bw_bytes = 0;
+        for (int i = first; i < run.total(); ++i)
+        {
+            bw_bytes += run.size_of(i);
+        }
+        double bw_s = (run.recv_ns[run.total() - 1] - run.sent_ns[first]) / 1e9;
+
+        std::cout << transport << "," << options.sender_cpu << "," << options.receiver_cpu << ","
+                  << run.latency_messages << "," << run.latency_size << "," << sum / run.latency_messages << ","
+                  << percentile(latency_us, 0.5) << "," << percentile(latency_us, 0.99) << ","
+                  << latency_us.back() << "," << bw_bytes << "," << bw_bytes / bw_s << std::endl;
+
+        if (histogram)
+        {
+            // Buckets [0, 1), [1, 2), [2, 4), ... microseconds
+            std::vector<int> buckets;
+            for (size_t i = 0; i < latency_us.size(); ++i)
+            {
+                size_t b = 0;
+                while (latency_us[i] >= (double)(1ull << b) && b < 63)
+                {
+                    ++b;
+                }
+                if (buckets.size() <= b)
+                {
+                    buckets.resize(b + 1, 0);
+                }
+                ++buckets[b];
+            }
+            size_t b = 0;
+            while (buckets[b] == 0)
+            {
+                ++b;
+            }
+            for (; b < buckets.size(); ++b)
+            {
+                histogram << transport << "," << (b == 0 ? 0 : 1ull << (b - 1)) << "," << (1ull << b) << ","
+                          << buckets[b] << "\n";
+            }
+        }
+        munmap(shared, stamps);
+    }
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * Real-time signal protocol shared by signal_sender and signal_receiver (--rt)
+ *
+ * Unlike SIGUSR1/SIGUSR2, real-time signals are queued: every sigqueue() is
+ * delivered once, in order, with the int it carries (si_value). So a whole
+ * 4-byte word goes in one signal, and no delay between signals is needed.
+ *
+ * Message format (sender -> receiver, all on RT_DATA_SIGNAL):
+ * - First word: the message length in bytes
+ * - Then (length + 3) / 4 data words, 4 bytes each, first byte in the low
+ *   8 bits; the unused bytes of the last word are zero
+ *
+ * Flow control (receiver -> sender, on RT_ACK_SIGNAL):
+ * - The receiver acknowledges with the number of words of the current
+ *   message (length word included) it has taken in so far, every
+ *   RT_ACK_EVERY words and when the message is complete
+ * - The sender keeps at most RT_WINDOW words unacknowledged, which bounds
+ *   how much of the kernel's per-user signal queue one message can fill
+ * - The sender waits for the final acknowledgement before the next message,
+ *   so the count starts again from 0 for every message
+ *
+ * Both sides block the two signals and take them with sigwaitinfo() or
+ * sigtimedwait(): the default action of a real-time signal is to terminate,
+ * and synchronous waiting means no handler has to touch the message buffer.
+ */
+
+#ifndef RT_PROTOCOL_HPP
+#define RT_PROTOCOL_HPP
+
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+// SIGRTMIN is not a constant expression in glibc, hence functions
+inline int rt_data_signal() { return SIGRTMIN; }
+inline int rt_ack_signal() { return SIGRTMIN + 1; }
+
+const int RT_WINDOW = 64;                 // unacknowledged words the sender may have queued
+const int RT_ACK_EVERY = RT_WINDOW / 2;   // the receiver acknowledges this often
+const int RT_ACK_TIMEOUT_MS = 1000;       // the sender checks the receiver is alive after this long
+const int RT_ACK_RETRIES = 5;             // and gives up after this many silent timeouts
+const uint32_t RT_MAX_LENGTH = 1u << 30;  // longest message the receiver accepts
+const uint32_t RT_RESERVE_MAX = 64 << 10; // reserved up front at most; longer messages grow as they arrive
+
+// Number of data words for a message of len bytes
+inline uint32_t rt_data_words(uint32_t len)
+{
+    return (len + 3) / 4;
+}
+
+// Bytes [4 * index, 4 * index + 4) of the message, packed into a word
+inline int rt_pack_word(const std::string &message, uint32_t index)
+{
+    uint32_t word = 0;
+    for (uint32_t k = 0; k < 4 && 4 * index + k < message.size(); ++k)
+    {
+        word |= (uint32_t)(unsigned char)message[4 * index + k] << (8 * k);
+    }
+    return (int)word;
+}
+
+/*
+ * Receiving side of one sender: feed every word from that sender to
+ * rt_receive_word() in order
+ */
+struct RtReceiveState
+{
+    bool in_message;     // the length word has been seen
+    uint32_t length;     // of the current message, in bytes
+    uint32_t words;      // words of the current message taken in, length word included
+    std::string message; // bytes so far
+
+    RtReceiveState() : in_message(false), length(0), words(0) {}
+};
+
+enum RtReceiveResult
+{
+    RT_MORE,     // keep going
+    RT_COMPLETE, // state.message holds a whole message; the next word starts a new one
+    RT_INVALID   // the length word was out of range; the state was reset
+};
+
+inline RtReceiveResult rt_receive_word(RtReceiveState &state, int value)
+{
+    uint32_t word = (uint32_t)value;
+    if (!state.in_message)
+    {
+        if (word > RT_MAX_LENGTH)
+        {
+            state = RtReceiveState();
+            return RT_INVALID;
+        }
+        state.in_message = true;
+        state.length = word;
+        state.words = 1;
+        state.message.clear();
+        // The length comes from whoever can signal us: don't let it
+        // allocate more than the words that actually arrive
+        state.message.reserve(word < RT_RESERVE_MAX ? word : RT_RESERVE_MAX);
+    }
+    else
+    {
+        for (int k = 0; k < 4 && state.message.size() < state.length; ++k)
+        {
+            state.message += (char)(word >> (8 * k));
+        }
+        ++state.words;
+    }
+
+    if (state.words == 1 + rt_data_words(state.length))
+    {
+        state.in_message = false;
+        return RT_COMPLETE;
+    }
+    return RT_MORE;
+}
+
+// Whether the word just taken in (with result r) calls for an acknowledgement
+inline bool rt_ack_due(const RtReceiveState &state, RtReceiveResult r)
+{
+    return r == RT_COMPLETE || state.words % RT_ACK_EVERY == 0;
+}
+
+// Tells pid that words words of its current message arrived; false if pid is gone
+inline bool rt_send_ack(pid_t pid, uint32_t words)
+{
+    union sigval value;
+    value.sival_int = (int)words;
+    return sigqueue(pid, rt_ack_signal(), value) == 0;
+}
+
+#endif
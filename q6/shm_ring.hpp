@@ -0,0 +1,329 @@
+/*
+ * Shared-memory ring buffer shared by signal_sender and signal_receiver (--shm)
+ *
+ * The receiver creates a POSIX shared memory segment named after its PID
+ * (shm_ring_name()), so the PID the sender already asks for is all it needs
+ * to find it. The data goes through the segment; no signal is sent at all.
+ *
+ * Ring:
+ * - Single producer (one sender at a time, see producer_pid), single consumer
+ *   (the receiver), lock-free: head is only written by the producer, tail only
+ *   by the consumer, and both count bytes since the start, modulo 2^32
+ * - The capacity is a power of two, so a position is counter & (capacity - 1)
+ *   and head - tail is the number of bytes waiting even after wrapping
+ *
+ * Doorbell:
+ * - A side that finds the ring empty (consumer) or full (producer) sets its
+ *   sleeping flag, checks again and sleeps in futex(FUTEX_WAIT) on the other
+ *   side's counter; the other side calls futex(FUTEX_WAKE) after moving its
+ *   counter, but only if the flag is set, so a busy ring costs no system call
+ * - Flag and counter are seq_cst on both sides, so either the sleeper sees
+ *   the new counter or the waker sees the flag: no wakeup is lost
+ * - Sleeps time out after a while, so a side can notice its peer exited
+ *
+ * Messages (framing on top of the byte stream, see signal_sender.cpp):
+ * - A 4-byte length, then the bytes of the message
+ * - The receiver skips the bytes of a message longer than SHM_MAX_LENGTH:
+ *   the length comes from whoever maps the segment
+ */
+
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+const uint32_t SHM_RING_MAGIC = 0x51365247;       // "Q6RG", written last by the receiver
+const uint32_t SHM_RING_CAPACITY = 1u << 20;      // bytes of data in the ring
+const int SHM_RING_TIMEOUT_MS = 1000;             // longest futex sleep before checking on the peer
+const uint32_t SHM_MAX_LENGTH = 1u << 30;         // longest message the receiver accepts
+const uint32_t SHM_RESERVE_MAX = 64 << 10;        // reserved up front at most; longer messages grow as they arrive
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit words");
+
+/*
+ * Start of the segment; the data follows it. Counters written by different
+ * sides are on different cache lines, so the two sides don't slow each
+ * other down by writing to the same line.
+ */
+struct ShmRingHeader
+{
+    std::atomic<uint32_t> magic;
+    uint32_t capacity;
+    pid_t receiver_pid;
+    std::atomic<pid_t> producer_pid;        // sender using the ring, 0 if none
+
+    alignas(64) std::atomic<uint32_t> head; // bytes written, by the producer
+    std::atomic<uint32_t> consumer_sleeping;
+
+    alignas(64) std::atomic<uint32_t> tail; // bytes read, by the consumer
+    std::atomic<uint32_t> producer_sleeping;
+};
+
+struct ShmRing
+{
+    ShmRingHeader *header;
+    char *data;
+    size_t map_size;
+
+    ShmRing() : header(nullptr), data(nullptr), map_size(0) {}
+};
+
+// Name of the segment of the receiver with the given PID
+inline std::string shm_ring_name(pid_t receiver)
+{
+    return "/q6_ring_" + std::to_string(receiver);
+}
+
+inline size_t shm_ring_data_offset()
+{
+    return (sizeof(ShmRingHeader) + 63) / 64 * 64;
+}
+
+/*
+ * Function: shm_ring_create
+ * -------------------------
+ * Creates, sizes and maps the segment of this process (receiver side)
+ *
+ * Returns false (errno set) if the segment already exists or can't be made.
+ */
+inline bool shm_ring_create(ShmRing &ring, uint32_t capacity)
+{
+    std::string name = shm_ring_name(getpid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+    {
+        return false;
+    }
+    size_t size = shm_ring_data_offset() + capacity;
+    if (ftruncate(fd, (off_t)size) == -1)
+    {
+        int saved = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        errno = saved;
+        return false;
+    }
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        int saved = errno;
+        shm_unlink(name.c_str());
+        errno = saved;
+        return false;
+    }
+
+    // ftruncate() zero-filled the segment; set the fields, then the magic
+    ring.header = static_cast<ShmRingHeader *>(map);
+    ring.data = static_cast<char *>(map) + shm_ring_data_offset();
+    ring.map_size = size;
+    ring.header->capacity = capacity;
+    ring.header->receiver_pid = getpid();
+    ring.header->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+    return true;
+}
+
+/*
+ * Function: shm_ring_open
+ * -----------------------
+ * Maps the segment of the receiver with the given PID (sender side)
+ *
+ * Returns false if there is no such segment or it is not a ring.
+ */
+inline bool shm_ring_open(ShmRing &ring, pid_t receiver)
+{
+    int fd = shm_open(shm_ring_name(receiver).c_str(), O_RDWR, 0);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size > shm_ring_data_offset())
+    {
+        map = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    ShmRingHeader *header = static_cast<ShmRingHeader *>(map);
+    if (header->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC ||
+        shm_ring_data_offset() + header->capacity != (size_t)st.st_size)
+    {
+        munmap(map, (size_t)st.st_size);
+        errno = EINVAL;
+        return false;
+    }
+    ring.header = header;
+    ring.data = static_cast<char *>(map) + shm_ring_data_offset();
+    ring.map_size = (size_t)st.st_size;
+    return true;
+}
+
+// Unmaps the segment; the receiver also removes its name
+inline void shm_ring_close(ShmRing &ring, bool unlink)
+{
+    if (ring.header == nullptr)
+    {
+        return;
+    }
+    if (unlink)
+    {
+        shm_unlink(shm_ring_name(ring.header->receiver_pid).c_str());
+    }
+    munmap(ring.header, ring.map_size);
+    ring = ShmRing();
+}
+
+/*
+ * Function: shm_ring_sleep
+ * ------------------------
+ * Sleeps until word changes from seen, at most timeout_ms
+ *
+ * Returns false on timeout or when a signal interrupted the sleep.
+ */
+inline bool shm_ring_sleep(std::atomic<uint32_t> &word, uint32_t seen, std::atomic<uint32_t> &sleeping,
+                           int timeout_ms)
+{
+    sleeping.store(1);
+    if (word.load() != seen)
+    {
+        sleeping.store(0);
+        return true;
+    }
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    // Not FUTEX_WAIT_PRIVATE: the word is shared between processes
+    long rc = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+    sleeping.store(0);
+    return rc == 0 || errno == EAGAIN; // EAGAIN: word had changed already
+}
+
+// Wakes the peer sleeping on word, if it is
+inline void shm_ring_wake(std::atomic<uint32_t> &word, std::atomic<uint32_t> &sleeping)
+{
+    if (sleeping.load())
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+/*
+ * Function: shm_ring_write
+ * ------------------------
+ * Copies all len bytes into the ring (producer side), sleeping whenever it
+ * is full
+ *
+ * Returns false if the receiver exited before taking the bytes.
+ */
+inline bool shm_ring_write(ShmRing &ring, const char *bytes, size_t len)
+{
+    ShmRingHeader &h = *ring.header;
+    uint32_t mask = h.capacity - 1;
+    uint32_t head = h.head.load(std::memory_order_relaxed);
+    while (len > 0)
+    {
+        uint32_t tail = h.tail.load(std::memory_order_acquire);
+        uint32_t space = h.capacity - (head - tail);
+        if (space == 0)
+        {
+            if (!shm_ring_sleep(h.tail, tail, h.producer_sleeping, SHM_RING_TIMEOUT_MS) &&
+                kill(h.receiver_pid, 0) == -1 && errno == ESRCH)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        uint32_t n = len < space ? (uint32_t)len : space;
+        uint32_t at = head & mask;
+        uint32_t first = n < h.capacity - at ? n : h.capacity - at;
+        memcpy(ring.data + at, bytes, first);
+        memcpy(ring.data, bytes + first, n - first);
+
+        head += n;
+        bytes += n;
+        len -= n;
+        h.head.store(head); // seq_cst: see the doorbell in the header comment
+        shm_ring_wake(h.head, h.consumer_sleeping);
+    }
+    return true;
+}
+
+/*
+ * Function: shm_ring_drain
+ * ------------------------
+ * Waits until the consumer has read everything written (producer side)
+ *
+ * Returns false if the receiver exited first.
+ */
+inline bool shm_ring_drain(ShmRing &ring)
+{
+    ShmRingHeader &h = *ring.header;
+    uint32_t head = h.head.load(std::memory_order_relaxed);
+    uint32_t tail;
+    while ((tail = h.tail.load(std::memory_order_acquire)) != head)
+    {
+        if (!shm_ring_sleep(h.tail, tail, h.producer_sleeping, SHM_RING_TIMEOUT_MS) &&
+            kill(h.receiver_pid, 0) == -1 && errno == ESRCH)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Function: shm_ring_read
+ * -----------------------
+ * Copies up to max bytes out of the ring (consumer side), sleeping up to
+ * timeout_ms while it is empty
+ *
+ * Returns the number of bytes read; 0 after a timeout or a signal.
+ */
+inline size_t shm_ring_read(ShmRing &ring, char *bytes, size_t max, int timeout_ms)
+{
+    ShmRingHeader &h = *ring.header;
+    uint32_t mask = h.capacity - 1;
+    uint32_t tail = h.tail.load(std::memory_order_relaxed);
+    uint32_t head = h.head.load(std::memory_order_acquire);
+    if (head == tail)
+    {
+        if (!shm_ring_sleep(h.head, head, h.consumer_sleeping, timeout_ms))
+        {
+            return 0;
+        }
+        head = h.head.load(std::memory_order_acquire);
+    }
+
+    uint32_t waiting = head - tail;
+    uint32_t n = max < waiting ? (uint32_t)max : waiting;
+    uint32_t at = tail & mask;
+    uint32_t first = n < h.capacity - at ? n : h.capacity - at;
+    memcpy(bytes, ring.data + at, first);
+    memcpy(bytes + first, ring.data, n - first);
+
+    h.tail.store(tail + n); // seq_cst: see the doorbell in the header comment
+    shm_ring_wake(h.tail, h.producer_sleeping);
+    return n;
+}
+
+#endif
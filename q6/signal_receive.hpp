@@ -0,0 +1,438 @@
+/*
+ * Receiving side of the --rt, --signalfd and --shm modes, shared by
+ * signal_receiver and ipc_bench
+ *
+ * Each receive_*() loop sets its transport up, calls handler.ready() once a
+ * sender may start (signal_receiver prints its PID there), and hands every
+ * complete message to the handler. What is done with a message is all that
+ * differs between the two programs: signal_receiver prints it, ipc_bench
+ * takes a timestamp.
+ *
+ * The loops run until the handler returns false, and check
+ * handler.keep_going() whenever they wake up without data, so a caller can
+ * stop them from outside.
+ */
+
+#ifndef SIGNAL_RECEIVE_HPP
+#define SIGNAL_RECEIVE_HPP
+
+#include <iostream>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "rt_protocol.hpp"
+#include "shm_ring.hpp"
+
+class ReceiveHandler
+{
+public:
+    virtual ~ReceiveHandler() {}
+
+    // The receiver can take messages from now on
+    virtual void ready() = 0;
+
+    // A whole message from sender; false ends the loop
+    virtual bool message(pid_t sender, const std::string &message) = 0;
+
+    // A whole legacy byte (SIGUSR1/SIGUSR2 bits, --signalfd only); false ends the loop
+    virtual bool number(pid_t sender, int value) = 0;
+
+    // Asked whenever a loop wakes up without data; false ends the loop
+    virtual bool keep_going() { return true; }
+};
+
+/*
+ * Function: receive_rt
+ * --------------------
+ * The --rt receiver: takes the data signals from the queue with
+ * sigtimedwait() and acknowledges them
+ *
+ * Words from a second sender while a message is in progress are dropped
+ * (that sender times out). When the current sender exits mid-message, the
+ * timeout notices and the partial message is discarded.
+ */
+inline int receive_rt(ReceiveHandler &handler)
+{
+    // Blocked before ready(), so no word can arrive unblocked
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, rt_data_signal());
+    sigprocmask(SIG_BLOCK, &set, nullptr);
+
+    handler.ready();
+
+    struct timespec timeout;
+    timeout.tv_sec = RT_ACK_TIMEOUT_MS / 1000;
+    timeout.tv_nsec = (RT_ACK_TIMEOUT_MS % 1000) * 1000000L;
+
+    RtReceiveState state;
+    pid_t sender = 0;
+    while (true)
+    {
+        siginfo_t info;
+        if (sigtimedwait(&set, &info, &timeout) == -1)
+        {
+            if (errno == EAGAIN && state.in_message && kill(sender, 0) == -1)
+            {
+                std::cerr << "Sender " << sender << " exited mid-message" << std::endl;
+                state = RtReceiveState();
+            }
+            else if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("sigtimedwait");
+                return 1;
+            }
+            if (!handler.keep_going())
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        // A plain kill() carries no word
+        if (info.si_code != SI_QUEUE || (state.in_message && info.si_pid != sender))
+        {
+            continue;
+        }
+        sender = info.si_pid;
+
+        RtReceiveResult r = rt_receive_word(state, info.si_value.sival_int);
+        if (r == RT_INVALID)
+        {
+            std::cerr << "Invalid message length from " << sender << std::endl;
+            continue;
+        }
+        if (rt_ack_due(state, r) && !rt_send_ack(sender, state.words))
+        {
+            state = RtReceiveState(); // The sender is gone
+            continue;
+        }
+        if (r == RT_COMPLETE && !handler.message(sender, state.message))
+        {
+            return 0;
+        }
+    }
+}
+
+/*
+ * What the --signalfd receiver knows about one sender
+ */
+struct SenderState
+{
+    int bits;           // legacy protocol: the number so far
+    int bit_count;      // legacy protocol: bits received (0-8)
+    RtReceiveState rt;  // --rt protocol
+    bool ack_pending;   // an acknowledgement is due at the end of the batch
+
+    SenderState() : bits(0), bit_count(0), ack_pending(false) {}
+};
+
+const int SIGNALFD_BATCH = 64; // siginfo records taken per read()
+
+/*
+ * Function: take_signal
+ * ---------------------
+ * Applies one signal read from the signalfd to the state of its sender
+ *
+ * SIGUSR1/SIGUSR2 are bits of the legacy protocol. They are not queued: two
+ * senders sending the same bit at the same time may merge into one signal, so
+ * only the --rt protocol is safe with concurrent senders.
+ *
+ * Returns what the handler returned for a completed message or number, true
+ * otherwise.
+ */
+inline bool take_signal(std::map<pid_t, SenderState> &senders, const struct signalfd_siginfo &info,
+                        ReceiveHandler &handler)
+{
+    pid_t pid = (pid_t)info.ssi_pid;
+    SenderState &sender = senders[pid];
+
+    if ((int)info.ssi_signo == SIGUSR1 || (int)info.ssi_signo == SIGUSR2)
+    {
+        sender.bits = (sender.bits << 1) | ((int)info.ssi_signo == SIGUSR2 ? 1 : 0);
+        if (++sender.bit_count == 8)
+        {
+            int value = sender.bits;
+            sender.bits = 0;
+            sender.bit_count = 0;
+            return handler.number(pid, value);
+        }
+        return true;
+    }
+
+    // A plain kill() of the data signal carries no word
+    if (info.ssi_code != SI_QUEUE)
+    {
+        return true;
+    }
+    RtReceiveResult r = rt_receive_word(sender.rt, info.ssi_int);
+    if (r == RT_INVALID)
+    {
+        std::cerr << "Invalid message length from " << pid << std::endl;
+        return true;
+    }
+    if (rt_ack_due(sender.rt, r))
+    {
+        sender.ack_pending = true;
+    }
+    return r != RT_COMPLETE || handler.message(pid, sender.rt.message);
+}
+
+/*
+ * Function: receive_signalfd
+ * --------------------------
+ * The --signalfd receiver: the signals are blocked and read as data from a
+ * signalfd, which sits in an epoll loop next to a timer
+ *
+ * - Every wakeup drains the signalfd completely, SIGNALFD_BATCH signals per
+ *   read(), instead of one handler call per signal
+ * - Within a batch, acknowledgements are merged: each sender gets at most one,
+ *   with its latest count, which is all the --rt sender needs
+ * - The timer drops the state of senders that exited
+ *
+ * When the handler ends the loop, the rest of the batch is still taken in
+ * and acknowledged, so no sender is left waiting.
+ */
+inline int receive_signalfd(ReceiveHandler &handler)
+{
+    // Blocked before ready(), so no signal can arrive unblocked
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, rt_data_signal());
+    sigprocmask(SIG_BLOCK, &set, nullptr);
+
+    int sfd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (sfd == -1 || tfd == -1 || epfd == -1)
+    {
+        perror("signalfd setup");
+        return 1;
+    }
+
+    struct itimerspec sweep;
+    sweep.it_interval.tv_sec = RT_ACK_TIMEOUT_MS / 1000;
+    sweep.it_interval.tv_nsec = (RT_ACK_TIMEOUT_MS % 1000) * 1000000L;
+    sweep.it_value = sweep.it_interval;
+    timerfd_settime(tfd, 0, &sweep, nullptr);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = sfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev);
+    ev.data.fd = tfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev);
+
+    handler.ready();
+
+    std::map<pid_t, SenderState> senders;
+    struct signalfd_siginfo batch[SIGNALFD_BATCH];
+    bool done = false;
+    while (!done)
+    {
+        struct epoll_event events[2];
+        int ready = epoll_wait(epfd, events, 2, -1);
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            return 1;
+        }
+
+        for (int e = 0; e < ready; ++e)
+        {
+            if (events[e].data.fd == tfd)
+            {
+                uint64_t expirations;
+                if (read(tfd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations))
+                {
+                    continue;
+                }
+                for (std::map<pid_t, SenderState>::iterator it = senders.begin(); it != senders.end();)
+                {
+                    if (kill(it->first, 0) == -1 && errno == ESRCH)
+                    {
+                        if (it->second.rt.in_message || it->second.bit_count > 0)
+                        {
+                            std::cerr << "Sender " << it->first << " exited mid-message" << std::endl;
+                        }
+                        senders.erase(it++);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+                done = done || !handler.keep_going();
+                continue;
+            }
+
+            // Drain the signalfd: the fd is non-blocking, so read() fails with
+            // EAGAIN once the queue is empty
+            ssize_t got;
+            while ((got = read(sfd, batch, sizeof(batch))) > 0)
+            {
+                size_t count = (size_t)got / sizeof(batch[0]);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    done = !take_signal(senders, batch[i], handler) || done;
+                }
+            }
+            if (got == -1 && errno != EAGAIN && errno != EINTR)
+            {
+                perror("read signalfd");
+                return 1;
+            }
+
+            for (std::map<pid_t, SenderState>::iterator it = senders.begin(); it != senders.end(); ++it)
+            {
+                if (it->second.ack_pending)
+                {
+                    it->second.ack_pending = false;
+                    if (!rt_send_ack(it->first, it->second.rt.words))
+                    {
+                        it->second.rt = RtReceiveState(); // The sender is gone
+                    }
+                }
+            }
+        }
+    }
+    close(epfd);
+    close(tfd);
+    close(sfd);
+    return 0;
+}
+
+// --shm: set by SIGINT/SIGTERM. A function-local static, so that the header
+// defines one flag however many files include it
+inline volatile sig_atomic_t &shm_stop_requested()
+{
+    static volatile sig_atomic_t requested = 0;
+    return requested;
+}
+
+inline void handle_shm_stop(int)
+{
+    shm_stop_requested() = 1;
+}
+
+/*
+ * Function: receive_shm
+ * ---------------------
+ * The --shm receiver: creates the ring, then reads messages (a 4-byte length,
+ * then the bytes) from it until the handler stops it, or SIGINT or SIGTERM
+ * arrives; the segment is removed in either case
+ *
+ * When the sender using the ring exits, the next timeout notices: a partial
+ * message is discarded and the ring is free for the next sender. A message
+ * longer than SHM_MAX_LENGTH is read past and dropped, and the string only
+ * grows as bytes arrive, so no length can make the receiver allocate more
+ * than SHM_MAX_LENGTH.
+ */
+inline int receive_shm(ReceiveHandler &handler)
+{
+    // No SA_RESTART: the signal interrupts the futex sleep, so the loop ends
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_shm_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    ShmRing ring;
+    if (!shm_ring_create(ring, SHM_RING_CAPACITY))
+    {
+        perror("shm_ring_create");
+        return 1;
+    }
+    handler.ready();
+
+    ShmRingHeader &h = *ring.header;
+    char buffer[65536];
+    uint32_t length = 0;
+    size_t length_bytes = 0; // of the 4-byte length read so far
+    uint32_t received = 0;   // of the message's bytes
+    bool skip = false;       // the message is too long: read past it
+    std::string message;
+    while (!shm_stop_requested())
+    {
+        size_t want = length_bytes < sizeof(length) ? sizeof(length) - length_bytes : length - received;
+        size_t got = shm_ring_read(ring, buffer, want < sizeof(buffer) ? want : sizeof(buffer), SHM_RING_TIMEOUT_MS);
+        if (got == 0)
+        {
+            pid_t producer = h.producer_pid.load();
+            if (producer != 0 && kill(producer, 0) == -1 && errno == ESRCH)
+            {
+                if (length_bytes > 0)
+                {
+                    std::cerr << "Sender " << producer << " exited mid-message" << std::endl;
+                }
+                // The producer is gone, so its counter can be taken over
+                h.tail.store(h.head.load());
+                length_bytes = 0;
+                received = 0;
+                message.clear();
+                h.producer_pid.store(0);
+            }
+            if (!handler.keep_going())
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (length_bytes < sizeof(length))
+        {
+            memcpy(reinterpret_cast<char *>(&length) + length_bytes, buffer, got);
+            length_bytes += got;
+            if (length_bytes == sizeof(length))
+            {
+                received = 0;
+                message.clear();
+                skip = length > SHM_MAX_LENGTH;
+                if (skip)
+                {
+                    std::cerr << "Invalid message length " << length << " from " << h.producer_pid.load() << std::endl;
+                }
+                else
+                {
+                    message.reserve(length < SHM_RESERVE_MAX ? length : SHM_RESERVE_MAX);
+                }
+            }
+        }
+        else
+        {
+            if (!skip)
+            {
+                message.append(buffer, got);
+            }
+            received += (uint32_t)got;
+        }
+
+        if (length_bytes == sizeof(length) && received == length)
+        {
+            length_bytes = 0;
+            if (!skip && !handler.message(h.producer_pid.load(), message))
+            {
+                break;
+            }
+        }
+    }
+
+    shm_ring_close(ring, true);
+    return 0;
+}
+
+#endif
@@ -15,12 +15,29 @@
  * 1. Using sigaction instead of signal - more advanced and safer
  * 2. Using sa_mask to block SIGUSR1 and SIGUSR2 during handling - prevents race conditions
  * 3. Using pause() instead of sleep() - doesn't lose signals that arrive during wait time
+ *
+ * With --rt, messages of any length arrive as real-time signals instead, one
+ * word per signal (see rt_protocol.hpp). The receiver keeps running and prints
+ * every message; one sender at a time is served.
+ *
+ * With --signalfd, the signals of both protocols are read from a signalfd in
+ * an epoll loop instead, in batches, and any number of senders is served at
+ * once, each keyed by its PID.
+ *
+ * With --shm, messages arrive through a ring buffer in shared memory, set up
+ * under this process's PID (see shm_ring.hpp); no signals carry data.
+ *
+ * The loops of these three modes live in signal_receive.hpp, which ipc_bench
+ * runs as well; this file only says what to do with a message.
  * ===============================================================================
  */
 
 #include <iostream>
 #include <csignal>
+#include <cstring>
+#include <string>
 #include <unistd.h>
+#include "signal_receive.hpp"
 
 
 volatile sig_atomic_t bit_count = 0;  // Counter for the number of bits received (0-8)
@@ -68,6 +85,49 @@ void handle_sigusr(int sig)
     }
 }
 
+/*
+ * What the --rt, --signalfd and --shm loops of signal_receive.hpp do here:
+ * print the PID once they are set up, and every message as it completes
+ */
+class PrintingHandler : public ReceiveHandler
+{
+public:
+    // --signalfd serves several senders at once, so it names them
+    explicit PrintingHandler(bool name_senders) : name_senders(name_senders) {}
+
+    void ready() override
+    {
+        std::cout << "My PID is " << getpid() << std::endl;
+    }
+
+    bool message(pid_t sender, const std::string &message) override
+    {
+        print(sender, message);
+        return true;
+    }
+
+    bool number(pid_t sender, int value) override
+    {
+        print(sender, std::to_string(value));
+        return true;
+    }
+
+private:
+    bool name_senders;
+
+    void print(pid_t sender, const std::string &text)
+    {
+        if (name_senders)
+        {
+            std::cout << "Received from " << sender << ": " << text << std::endl;
+        }
+        else
+        {
+            std::cout << "Received " << text << std::endl;
+        }
+    }
+};
+
 /*
  * Main function - prepares the program to receive signals
  * 
@@ -75,9 +135,33 @@ void handle_sigusr(int sig)
  * 1. Print the PID of the current process (so the sender can identify us)
  * 2. Set up an advanced signal handler with sigaction
  * 3. Wait indefinitely for signals with pause()
+ *
+ * With --rt, receive_rt() runs instead, with --signalfd receive_signalfd() and
+ * with --shm receive_shm(), all from signal_receive.hpp.
  */
-int main()
+int main(int argc, char *argv[])
 {
+    if (argc == 2 && strcmp(argv[1], "--rt") == 0)
+    {
+        PrintingHandler handler(false);
+        return receive_rt(handler);
+    }
+    if (argc == 2 && strcmp(argv[1], "--signalfd") == 0)
+    {
+        PrintingHandler handler(true);
+        return receive_signalfd(handler);
+    }
+    if (argc == 2 && strcmp(argv[1], "--shm") == 0)
+    {
+        PrintingHandler handler(false);
+        return receive_shm(handler);
+    }
+    if (argc > 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--rt | --signalfd | --shm]" << std::endl;
+        return 1;
+    }
+
     // Print the process PID - the user will enter this in the sender program
     std::cout << "My PID is " << getpid() << std::endl;
 
@@ -0,0 +1,233 @@
+/*
+ * Sending side of the signal_sender protocols, shared by signal_sender and
+ * ipc_bench: the legacy bits (send_bit()), the --rt messages
+ * (send_message_rt(), see rt_protocol.hpp) and the --shm messages
+ * (send_message_shm(), see shm_ring.hpp)
+ *
+ * --rt callers block rt_ack_signal() before the first message, so the
+ * acknowledgements wait in the queue for wait_for_ack().
+ */
+
+#ifndef SIGNAL_SEND_HPP
+#define SIGNAL_SEND_HPP
+
+#include <iostream>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+#include "rt_protocol.hpp"
+#include "shm_ring.hpp"
+
+/*
+ * Function: send_bit
+ * ------------------
+ * Sends a single bit to the receiver program using signals
+ * 
+ * Parameters:
+ *   pid - Process ID of the receiver program
+ *   bit - The value of the bit to send (0 or 1)
+ * 
+ * Algorithm:
+ *   1. Choose the appropriate signal: SIGUSR1 for 0, SIGUSR2 for 1
+ *   2. Send the signal using the kill() system call
+ *   3. Check if the sending succeeded - if not, print error and exit
+ *   4. Wait 100ms (100,000 microseconds) before returning
+ * 
+ * Important note: The 100ms delay is critical to prevent signal loss!
+ *                 It gives the receiver enough time to process each signal before receiving the next one.
+ */
+inline void send_bit(pid_t pid, int bit)
+{
+    // Choose the appropriate signal according to the bit value
+    // SIGUSR1 = 0, SIGUSR2 = 1
+    int sig = (bit == 0) ? SIGUSR1 : SIGUSR2;
+    
+    // Send the signal to the receiver process
+    // kill() returns -1 in case of error
+    if (kill(pid, sig) == -1)
+    {
+        perror("Failed to send signal");
+        exit(1);
+    }
+
+    usleep(100000); // 100 milliseconds
+}
+
+/*
+ * Function: wait_for_ack
+ * ----------------------
+ * Waits for the next acknowledgement from the receiver (--rt mode)
+ *
+ * Parameters:
+ *   pid   - Process ID of the receiver program
+ *   acked - Set to the number of words the receiver has taken in
+ *
+ * Returns false if the receiver exited, or stayed silent for
+ * RT_ACK_RETRIES timeouts in a row.
+ *
+ * The acknowledgement signal is blocked, so sigtimedwait() takes it from the
+ * queue; signals from other processes (or plain kill()s) are skipped.
+ */
+inline bool wait_for_ack(pid_t pid, uint32_t &acked)
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, rt_ack_signal());
+
+    struct timespec timeout;
+    timeout.tv_sec = RT_ACK_TIMEOUT_MS / 1000;
+    timeout.tv_nsec = (RT_ACK_TIMEOUT_MS % 1000) * 1000000L;
+
+    int silent = 0;
+    while (1)
+    {
+        siginfo_t info;
+        if (sigtimedwait(&set, &info, &timeout) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Timeout (EAGAIN): is the receiver still there?
+            if (kill(pid, 0) == -1)
+            {
+                std::cerr << "Receiver " << pid << " exited" << std::endl;
+                return false;
+            }
+            if (++silent == RT_ACK_RETRIES)
+            {
+                std::cerr << "No acknowledgement from receiver " << pid << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if (info.si_code != SI_QUEUE || info.si_pid != pid)
+        {
+            continue;
+        }
+        acked = (uint32_t)info.si_value.sival_int;
+        return true;
+    }
+}
+
+/*
+ * Function: send_word
+ * -------------------
+ * Queues one word of a message to the receiver (--rt mode)
+ *
+ * Parameters:
+ *   pid   - Process ID of the receiver program
+ *   word  - The payload of the signal
+ *   sent  - Words of this message sent so far, incremented
+ *   acked - Words of this message acknowledged so far
+ *
+ * Flow control: with RT_WINDOW words unacknowledged, the function first waits
+ * for an acknowledgement. If the kernel's signal queue is full anyway (EAGAIN,
+ * e.g. other processes of the same user queue signals too), it waits for the
+ * receiver to catch up and tries again.
+ */
+inline bool send_word(pid_t pid, int word, uint32_t &sent, uint32_t &acked)
+{
+    while (sent - acked >= (uint32_t)RT_WINDOW)
+    {
+        if (!wait_for_ack(pid, acked))
+        {
+            return false;
+        }
+    }
+
+    union sigval value;
+    value.sival_int = word;
+    while (sigqueue(pid, rt_data_signal(), value) == -1)
+    {
+        if (errno != EAGAIN)
+        {
+            perror("Failed to send signal");
+            return false;
+        }
+        if (sent == acked)
+        {
+            usleep(1000); // Nothing of ours to acknowledge; the queue is full of others' signals
+        }
+        else if (!wait_for_ack(pid, acked))
+        {
+            return false;
+        }
+    }
+    ++sent;
+    return true;
+}
+
+/*
+ * Function: send_message_rt
+ * -------------------------
+ * Sends a message of any length (--rt mode): the length word, then 4 bytes
+ * per word, and waits until the receiver has acknowledged all of it
+ *
+ * Returns false if the receiver stopped responding.
+ */
+inline bool send_message_rt(pid_t pid, const std::string &message)
+{
+    if (message.size() > RT_MAX_LENGTH)
+    {
+        std::cerr << "Message too long (at most " << RT_MAX_LENGTH << " bytes)" << std::endl;
+        return false;
+    }
+
+    uint32_t length = (uint32_t)message.size();
+    uint32_t total = 1 + rt_data_words(length);
+    uint32_t sent = 0;
+    uint32_t acked = 0;
+
+    if (!send_word(pid, (int)length, sent, acked))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < rt_data_words(length); ++i)
+    {
+        if (!send_word(pid, rt_pack_word(message, i), sent, acked))
+        {
+            return false;
+        }
+    }
+
+    // The receiver acknowledges the last word in any case
+    while (acked != total)
+    {
+        if (!wait_for_ack(pid, acked))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Function: send_message_shm
+ * --------------------------
+ * Sends a message of any length through the ring (--shm mode): the 4-byte
+ * length, then the bytes, and waits until the receiver has read all of it
+ *
+ * Returns false if the receiver exited.
+ */
+inline bool send_message_shm(ShmRing &ring, const std::string &message)
+{
+    if (message.size() > SHM_MAX_LENGTH)
+    {
+        std::cerr << "Message too long (at most " << SHM_MAX_LENGTH << " bytes)" << std::endl;
+        return false;
+    }
+    uint32_t length = (uint32_t)message.size();
+    if (!shm_ring_write(ring, reinterpret_cast<const char *>(&length), sizeof(length)) ||
+        !shm_ring_write(ring, message.data(), message.size()) || !shm_ring_drain(ring))
+    {
+        std::cerr << "Receiver " << ring.header->receiver_pid << " exited" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
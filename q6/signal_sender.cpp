@@ -12,6 +12,13 @@
  * 1. Preventing signal loss - using usleep(100000) ensures a 100ms delay between
  *    each two signals, allowing the receiver to process each signal before receiving the next
  * 2. No signal queue - if sent too quickly, signals may be lost
+ *
+ * With --rt, a line of text of any length is sent instead, 4 bytes per
+ * real-time signal (see rt_protocol.hpp). Those signals are queued, so there
+ * is no delay: the receiver's acknowledgements pace the sender.
+ *
+ * With --shm, the lines go through a ring buffer in shared memory that the
+ * receiver (signal_receiver --shm) set up under its PID (see shm_ring.hpp).
  */
 
 #include <iostream>
@@ -19,41 +26,13 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <limits>
-
-/*
- * Function: send_bit
- * ------------------
- * Sends a single bit to the receiver program using signals
- * 
- * Parameters:
- *   pid - Process ID of the receiver program
- *   bit - The value of the bit to send (0 or 1)
- * 
- * Algorithm:
- *   1. Choose the appropriate signal: SIGUSR1 for 0, SIGUSR2 for 1
- *   2. Send the signal using the kill() system call
- *   3. Check if the sending succeeded - if not, print error and exit
- *   4. Wait 100ms (100,000 microseconds) before returning
- * 
- * Important note: The 100ms delay is critical to prevent signal loss!
- *                 It gives the receiver enough time to process each signal before receiving the next one.
- */
-void send_bit(pid_t pid, int bit)
-{
-    // Choose the appropriate signal according to the bit value
-    // SIGUSR1 = 0, SIGUSR2 = 1
-    int sig = (bit == 0) ? SIGUSR1 : SIGUSR2;
-    
-    // Send the signal to the receiver process
-    // kill() returns -1 in case of error
-    if (kill(pid, sig) == -1)
-    {
-        perror("Failed to send signal");
-        exit(1);
-    }
-
-    usleep(100000); // 100 milliseconds
-}
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include "rt_protocol.hpp"
+#include "shm_ring.hpp"
+#include "signal_send.hpp"
 
 /*
  * Main function - performs the complete sending process
@@ -62,12 +41,34 @@ void send_bit(pid_t pid, int bit)
  * 1. Get the PID of the receiver process from the user (with validation)
  * 2. Get the number to send (0-255, corresponding to 8 bits)
  * 3. Convert the number to binary representation and send each bit separately
+ *
+ * With --rt or --shm, steps 2 and 3 are replaced by: send every line entered
+ * as one message, until end of input.
  */
-int main()
+int main(int argc, char *argv[])
 {
     pid_t receiver_pid;  // Process ID of the receiver program
     int number;          // The number to send (must be in range 0-255 for 8 bits)
 
+    bool rt = argc == 2 && strcmp(argv[1], "--rt") == 0;
+    bool shm = argc == 2 && strcmp(argv[1], "--shm") == 0;
+    if (argc > 1 && !rt && !shm)
+    {
+        std::cerr << "Usage: " << argv[0] << " [--rt | --shm]" << std::endl;
+        return 1;
+    }
+
+    if (rt)
+    {
+        // Block the acknowledgement signal before anything is sent: unblocked,
+        // a real-time signal terminates the process, and wait_for_ack() takes it
+        // from the queue synchronously instead
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, rt_ack_signal());
+        sigprocmask(SIG_BLOCK, &set, nullptr);
+    }
+
     // ===== Part 1: Get and validate PID =====
     // Loop that continues until a valid and available PID is received
     while (1)
@@ -90,6 +91,57 @@ int main()
         break; // Exit the loop - input is valid
     }
 
+    // ===== --shm: map the receiver's ring and take the producer side =====
+    ShmRing ring;
+    if (shm)
+    {
+        if (!shm_ring_open(ring, receiver_pid))
+        {
+            std::cerr << "No ring of receiver " << receiver_pid << " (is it running with --shm?)" << std::endl;
+            return 1;
+        }
+        // Single producer: one sender at a time
+        pid_t none = 0;
+        if (!ring.header->producer_pid.compare_exchange_strong(none, getpid()))
+        {
+            std::cerr << "Receiver " << receiver_pid << " is busy with sender " << none << std::endl;
+            return 1;
+        }
+    }
+
+    // ===== --rt, --shm: send lines of text until end of input =====
+    if (rt || shm)
+    {
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Rest of the PID line
+        std::string message;
+        bool ok = true;
+        while (ok && (std::cout << "Enter message: ", std::getline(std::cin, message)))
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ok = shm ? send_message_shm(ring, message) : send_message_rt(receiver_pid, message);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            if (ok && shm)
+            {
+                std::cout << "Sent " << message.size() << " bytes (" << us << " us)" << std::endl;
+            }
+            else if (ok)
+            {
+                std::cout << "Sent " << message.size() << " bytes in " << 1 + rt_data_words(message.size())
+                          << " signals (" << us << " us)" << std::endl;
+            }
+        }
+        if (shm)
+        {
+            ring.header->producer_pid.store(0);
+            shm_ring_close(ring, false);
+        }
+        if (ok)
+        {
+            std::cout << std::endl;
+        }
+        return ok ? 0 : 1;
+    }
+
     // ===== Part 2: Get and validate the number to send =====
     // Loop that continues until a valid number in range 0-255 is received
     while (1)
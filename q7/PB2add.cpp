@@ -3,20 +3,39 @@
  * @brief Exercise 7 - Add entry to phonebook (companion program to findPhone)
  * 
  * @details This program adds a new entry to the phonebook.txt file.
- *          -  file I/O using open(2) and write(2)
- *          - Manual string manipulation without string APIs
+ *          - The "name,phone" line is appended by append_entries(): under an
+ *            flock(2) on the file, with writev(2), and recorded in the
+ *            lookup index if there is one
+ *          - The name is gathered from argv character by character, the
+ *            line is built as a std::string
  *          - Input validation for security
  * 
  * @note Format: "Full Name,Phone-Number\n"
  *       Example: "Nezer Zaidenberg,054-5531415\n"
+ *
+ *       With --bulk, many entries are read from a CSV file or stdin and
+ *       added in large batches, see add_bulk().
  */
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <climits>
 #include <cstring>
 #include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include "phonebook_index.hpp"
 using namespace std;
 
+// Bytes of entries gathered before they are written (and the lock taken)
+const size_t BULK_BATCH_BYTES = 64 << 20;
+// Size of each buffer handed to writev(2)
+const size_t BULK_CHUNK_BYTES = 1 << 20;
+
 /**
  * @brief Validates that a name contains only letters, spaces, and apostrophes
  * 
@@ -47,6 +66,206 @@ bool is_valid_phone(const char* phone) {
     return true;
 }
 
+/**
+ * @brief Appends complete lines to phonebook.txt, and records them in the
+ *        lookup index, as one step
+ *
+ * @param chunks Buffers of whole "name,phone\n" lines, written in order
+ * @return true on success; on failure the phonebook is left as it was
+ *
+ * @details The flock(2) on phonebook.txt, which phonebookd takes as well,
+ *          is held throughout, so concurrent PB2adds never interleave their
+ *          lines and the daemon never sees lines without their log records.
+ *          - The buffers go out with writev(2), IOV_MAX at a time, and short
+ *            writes are resumed; if writing fails, the file is truncated back
+ *          - A phonebook whose last line lacks its newline gets one first, so
+ *            the first new entry isn't glued to it
+ *          - If the index exists (phonebook.txt.idx.log), a PbLogRecord per
+ *            new line is appended to it
+ */
+bool append_entries(const vector<string>& chunks) {
+    // O_RDWR rather than O_WRONLY, to read the last byte
+    int fd = open("phonebook.txt", O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        cerr << "Error: failed to open the file\n";
+        return false;
+    }
+    if (flock(fd, LOCK_EX) < 0) {
+        perror("Error: failed to lock the file");
+        close(fd);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("Error: failed to stat the file");
+        flock(fd, LOCK_UN);
+        close(fd);
+        return false;
+    }
+    uint64_t end = (uint64_t)st.st_size;
+    char last = '\n';
+    if (end > 0 && pread(fd, &last, 1, (off_t)(end - 1)) != 1) {
+        last = '\n';
+    }
+
+    vector<struct iovec> iov;
+    static char newline[] = "\n";
+    if (last != '\n') {
+        struct iovec v = {newline, 1};
+        iov.push_back(v);
+    }
+    vector<PbLogRecord> records;
+    uint64_t base = end + iov.size();
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        struct iovec v = {const_cast<char*>(chunks[i].data()), chunks[i].size()};
+        iov.push_back(v);
+        pb_scan_lines(chunks[i].data(), chunks[i].size(), base, records);
+        base += chunks[i].size();
+    }
+
+    bool ok = true;
+    size_t next = 0;
+    while (ok && next < iov.size()) {
+        int count = (int)min(iov.size() - next, (size_t)IOV_MAX);
+        ssize_t written = writev(fd, &iov[next], count);
+        if (written < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+        // Skip what was written; resume a partly written buffer
+        while (next < iov.size() && (size_t)written >= iov[next].iov_len) {
+            written -= iov[next].iov_len;
+            ++next;
+        }
+        if (written > 0) {
+            iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + written;
+            iov[next].iov_len -= written;
+        }
+    }
+    if (!ok) {
+        perror("Error: failed to write the file");
+        if (ftruncate(fd, (off_t)end) < 0) {
+            perror("Error: failed to undo the partial write");
+        }
+    } else {
+        // Without an index there is nothing to keep up to date
+        int log_fd = open("phonebook.txt.idx.log", O_WRONLY | O_APPEND);
+        if (log_fd >= 0) {
+            if (!pb_log_append(log_fd, records)) {
+                // The daemon scans unlogged lines itself, so this only costs time
+                perror("Warning: failed to update the index");
+            }
+            close(log_fd);
+        }
+    }
+
+    flock(fd, LOCK_UN);
+    if (close(fd) < 0 && ok) {
+        perror("Error: failed to write the file");
+        ok = false;
+    }
+    return ok;
+}
+
+// Drops blanks (and a '\r' of CRLF files) at both ends, and surrounding quotes
+string trim_field(const string& field) {
+    size_t start = 0;
+    size_t end = field.size();
+    while (start < end && (field[start] == ' ' || field[start] == '\t')) {
+        ++start;
+    }
+    while (end > start && (field[end - 1] == ' ' || field[end - 1] == '\t' || field[end - 1] == '\r')) {
+        --end;
+    }
+    if (end - start >= 2 && field[start] == '"' && field[end - 1] == '"') {
+        ++start;
+        --end;
+    }
+    return field.substr(start, end - start);
+}
+
+/**
+ * @brief Bulk mode: adds every "name,phone" line of input
+ *
+ * @param input CSV lines; blank lines are skipped
+ * @return 0 if every line was added, 1 if some were rejected or writing failed
+ *         (the batches written before a failed one stay, and are counted)
+ *
+ * @details Each line is validated like a single entry (is_valid_name,
+ *          is_valid_phone, at most 255 characters of name); rejected lines
+ *          are reported with their line number and left out. Accepted lines
+ *          are gathered into BULK_CHUNK_BYTES buffers, and every
+ *          BULK_BATCH_BYTES (and at the end) written by append_entries():
+ *          one lock and a few writev calls for up to millions of entries,
+ *          instead of one process each.
+ */
+int add_bulk(istream& input) {
+    vector<string> chunks(1);
+    size_t pending = 0;
+    size_t added = 0;
+    size_t written = 0;  // of added, in batches already appended
+    size_t rejected = 0;
+    size_t line_number = 0;
+    string line;
+
+    while (getline(input, line)) {
+        ++line_number;
+        size_t comma = line.find(',');
+        string name = trim_field(line.substr(0, comma));
+        string phone = comma == string::npos ? string() : trim_field(line.substr(comma + 1));
+        if (name.empty() && phone.empty()) {
+            continue;
+        }
+        if (name.empty() || name.size() > 255 || !is_valid_name(name.c_str())) {
+            cerr << "line " << line_number << ": invalid name: Name must contain letters or spaces only\n";
+            ++rejected;
+            continue;
+        }
+        if (phone.empty() || !is_valid_phone(phone.c_str())) {
+            cerr << "line " << line_number << ": invalid phone: Phone number must contain digits or hyphens only\n";
+            ++rejected;
+            continue;
+        }
+
+        if (chunks.back().size() >= BULK_CHUNK_BYTES) {
+            chunks.push_back(string());
+        }
+        string& chunk = chunks.back();
+        if (chunk.empty()) {
+            chunk.reserve(BULK_CHUNK_BYTES + 512);
+        }
+        chunk += name;
+        chunk += ',';
+        chunk += phone;
+        chunk += '\n';
+        pending += name.size() + phone.size() + 2;
+        ++added;
+
+        if (pending >= BULK_BATCH_BYTES) {
+            if (!append_entries(chunks)) {
+                cerr << "Added " << written << " entries before the failed batch (stopped at line "
+                     << line_number << ")\n";
+                return 1;
+            }
+            written = added;
+            chunks.assign(1, string());
+            pending = 0;
+        }
+    }
+    if (pending > 0 && !append_entries(chunks)) {
+        cerr << "Added " << written << " entries before the failed batch\n";
+        return 1;
+    }
+
+    cout << "Added " << added << " entries to phonebook!" << endl;
+    if (rejected > 0) {
+        cerr << rejected << " lines rejected\n";
+        return 1;
+    }
+    return 0;
+}
+
 /**
  * @brief Main function - Adds a new entry to the phonebook
  * 
@@ -59,11 +278,31 @@ bool is_valid_phone(const char* phone) {
  *          
  *          The name can contain multiple words (e.g., "John Doe" or "Sheva Bat").
  *          The last argument is always treated as the phone number.
+ *
+ *          Bulk usage: ./PB2add --bulk [file.csv]
+ *          Reads "Full Name,Phone-Number" lines from the file, or from stdin.
  */
 int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "--bulk") == 0) {
+        if (argc > 3) {
+            cerr << "Usage: ./PB2add --bulk [file.csv]\n";
+            return 1;
+        }
+        if (argc == 2 || strcmp(argv[2], "-") == 0) {
+            return add_bulk(cin);
+        }
+        ifstream file(argv[2]);
+        if (!file) {
+            cerr << "Error: failed to open " << argv[2] << "\n";
+            return 1;
+        }
+        return add_bulk(file);
+    }
+
     // Validate command line arguments
     if (argc < 3) {
         cerr << "Usage: ./PB2add  <full name> <phone number>\n";
+        cerr << "       ./PB2add --bulk [file.csv]\n";
         cerr << "run example: ./PB2add  John Doe 123-4567890\n";
         return 1;
     }
@@ -104,45 +343,18 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    int fd = open("phonebook.txt", O_WRONLY | O_APPEND | O_CREAT, 0644);
-    
-    // Check if the file was opened successfully
-     // O_WRONLY: Open for writing only
-     // O_APPEND: Append to the end of the file
-     // O_CREAT: Create the file if it does not exist
-     // 0644: File permissions (read/write for owner, read for group and others)
+    // The line as add_bulk builds it, so any phone length fits
+    string line = name;
+    line += ',';       // comma separator (required format)
+    line += phone;
+    line += '\n';      // each entry must be on its own line
 
-    if (fd < 0) {
-        cerr << "Error: failed to open the file\n";
+    // Written like a bulk batch of one: under the lock, with the result
+    // checked, and recorded in the lookup index
+    if (!append_entries(vector<string>(1, line))) {
         return 1;
     }
 
-    char buffer[512];
-    int index = 0;
-
-    // Copy name to buffer character by character
-    for (int i = 0; name[i] != '\0'; ++i) {
-        buffer[index++] = name[i];
-    }
-
-    // Add comma separator (required format)
-    buffer[index++] = ',';
-    
-    // Copy phone number to buffer character by character
-    for (int i = 0; phone[i] != '\0'; ++i) {
-        buffer[index++] = phone[i];
-    }
-    
-    // Add newline character (each entry must be on its own line)
-    buffer[index++] = '\n';
-    buffer[index] = '\0';  // Null-terminate (for safety, not required for write)
-
-    // Write to the file
-    write(fd, buffer, index);
-    
-    // Close the file descriptor using close(2)
-    close(fd);
-    
     cout << "Added successfully to phonebook!" <<endl;
     return 0;
 }
\ No newline at end of file
@@ -21,12 +21,25 @@ data channel that can be used for communication between processes.
  * 4. awk  - Extracting the phone number ({print $2})
  * 
  * All operations are performed using child processes connected via pipes.
+ *
+ * With --native, the same search runs inside the process instead (see
+ * find_native()), which saves the four fork/exec calls per lookup.
+ * With --query, the lookup daemon (phonebookd) answers from its index.
  */
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <iostream>
+#include <string>
 #include <cctype>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include "phonebook_index.hpp"
 using namespace std;
 
 /**
@@ -44,6 +57,136 @@ bool is_valid_name(const char* name) {
     return true;
 }
 
+/**
+ * @brief The grep | sed | sed | awk pipeline, inside the process
+ *
+ * @param name The name to search for (validated: no regex characters)
+ * @return 0 on success, 1 if phonebook.txt can't be read
+ *
+ * @details phonebook.txt is mapped with mmap(2) and scanned once: memmem(3)
+ *          (vectorized in glibc) jumps to the next occurrence of the name,
+ *          memrchr/memchr find the line around it, and the scan continues
+ *          after that line, so every matching line is printed once, like
+ *          grep. The output is the same as the pipeline's, in one write.
+ */
+int find_native(const char* name) {
+    int fd = open("phonebook.txt", O_RDONLY);
+    if (fd < 0) {
+        cerr << "findPhone: phonebook.txt: " << strerror(errno) << "\n";
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        cerr << "findPhone: phonebook.txt: " << strerror(errno) << "\n";
+        close(fd);
+        return 1;
+    }
+
+    string out;
+    size_t size = (size_t)st.st_size;
+    if (size > 0) {
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            cerr << "findPhone: phonebook.txt: " << strerror(errno) << "\n";
+            close(fd);
+            return 1;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+
+        const char* begin = static_cast<const char*>(map);
+        const char* end = begin + size;
+        size_t name_len = strlen(name);
+        const char* at = begin;
+        while (at < end) {
+            const char* hit = static_cast<const char*>(memmem(at, end - at, name, name_len));
+            if (hit == NULL) {
+                break;
+            }
+            // The line around the hit: hit itself can't be a newline, the name has none
+            const char* line = static_cast<const char*>(memrchr(at, '\n', hit - at));
+            line = line == NULL ? at : line + 1;
+            const char* eol = static_cast<const char*>(memchr(hit, '\n', end - hit));
+            if (eol == NULL) {
+                eol = end;
+            }
+            pb_append_phone(line, eol - line, out);
+            at = eol + 1;
+        }
+        munmap(map, size);
+    }
+    close(fd);
+
+    cout << "The phone number/s: " << endl;
+    cout << out;
+    return 0;
+}
+
+/**
+ * @brief Asks phonebookd for the phone numbers of the names starting with name
+ *
+ * @param name The name, or its first word(s), validated
+ * @return 0 on success, 1 if the daemon can't be reached
+ *
+ * @details Unlike grep, the index matches the whole normalized name (lower
+ *          case, single spaces) by prefix, so "micky" finds "Micky Mouse"
+ *          but "mouse" doesn't. See PB_SOCKET_NAME for the protocol.
+ */
+int find_query(const char* name) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, PB_SOCKET_NAME, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        cerr << "findPhone: no lookup daemon on " << PB_SOCKET_NAME << " (start ./phonebookd)\n";
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    string request = string("prefix ") + name + "\n";
+    if (write(fd, request.data(), request.size()) != (ssize_t)request.size()) {
+        perror("findPhone: write");
+        close(fd);
+        return 1;
+    }
+
+    // "<count>\n", then count lines
+    string reply;
+    char buffer[65536];
+    size_t header_end = string::npos;
+    long count = 0;
+    long lines = 0;
+    while (header_end == string::npos || lines < count) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got <= 0) {
+            cerr << "findPhone: the lookup daemon closed the connection\n";
+            close(fd);
+            return 1;
+        }
+        size_t from = reply.size();
+        reply.append(buffer, got);
+        if (header_end == string::npos) {
+            header_end = reply.find('\n');
+            if (header_end == string::npos) {
+                continue;
+            }
+            count = strtol(reply.c_str(), NULL, 10);
+            from = header_end + 1;
+        }
+        for (size_t i = from; i < reply.size(); ++i) {
+            lines += reply[i] == '\n';
+        }
+    }
+    reply.erase(0, header_end + 1);
+    close(fd);
+
+    cout << "The phone number/s: " << endl;
+    cout << reply;
+    return 0;
+}
+
 /**
  * @brief Main function - Creates a pipeline of child processes to search for phone numbers
  * 
@@ -60,11 +203,24 @@ bool is_valid_name(const char* name) {
  *          - pipe3: sed2 -> awk
  *          
  *          Each child process uses dup2(2) to redirect stdin/stdout to pipes.
+ *
+ *          Usage: ./findPhone [--native | --query] <first name>
+ *          With --native, find_native() replaces the pipeline, and with
+ *          --query find_query().
  */
 int main(int argc, char *argv[]) {
+    // --native: search in-process instead of through the pipeline
+    // --query: ask the lookup daemon
+    bool native = argc >= 2 && strcmp(argv[1], "--native") == 0;
+    bool query = argc >= 2 && strcmp(argv[1], "--query") == 0;
+    if (native || query) {
+        --argc;
+        ++argv;
+    }
+
     // Validate command line arguments
     if (argc < 2) {
-        cerr << "Usage: ./findPhone <first name>\n";
+        cerr << "Usage: ./findPhone [--native | --query] <first name>\n";
         return 1;
     }
     cout << "Notice:the program use the first name only (argv[1]) " << endl;
@@ -77,6 +233,14 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (native || query) {
+        int status = native ? find_native(name) : find_query(name);
+        if (status == 0) {
+            cout << "The program has finished " << endl;
+        }
+        return status;
+    }
+
     // Array to store PIDs of 4 child processes
     // This is essential for the exercise - demonstrating fork(2) usage
     pid_t pidArr[4];
@@ -0,0 +1,589 @@
+/**
+ * @file phonebook_index.cpp
+ * @brief Building, reading and updating the phonebook index, see phonebook_index.hpp
+ */
+#include "phonebook_index.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+string pb_normalize_name(const char* name, size_t len) {
+    string out;
+    out.reserve(len);
+    bool blank = false;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)name[i];
+        if (c == ' ' || c == '\t' || c == '\r') {
+            blank = true;
+            continue;
+        }
+        if (blank && !out.empty()) {
+            out += ' ';
+        }
+        blank = false;
+        out += (char)tolower(c);
+    }
+    return out;
+}
+
+uint32_t pb_hash_name(const string& normalized) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < normalized.size(); ++i) {
+        hash = (hash ^ (unsigned char)normalized[i]) * 16777619u;
+    }
+    return hash;
+}
+
+string pb_line_name(const char* line, size_t len) {
+    const char* comma = static_cast<const char*>(memchr(line, ',', len));
+    return pb_normalize_name(line, comma == NULL ? len : (size_t)(comma - line));
+}
+
+void pb_append_phone(const char* line, size_t len, string& out) {
+    string fields(line, len);
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i] == ' ') {
+            fields[i] = '#';
+        }
+    }
+    size_t comma = fields.find(',');
+    if (comma != string::npos) {
+        fields[comma] = ' ';
+    }
+
+    size_t i = 0;
+    for (int field = 1; ; ++field) {
+        while (i < fields.size() && (fields[i] == ' ' || fields[i] == '\t')) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < fields.size() && fields[i] != ' ' && fields[i] != '\t') {
+            ++i;
+        }
+        if (field == 2 || start == i) {
+            out.append(fields, start, i - start);
+            break;
+        }
+    }
+    out += '\n';
+}
+
+size_t pb_scan_lines(const char* bytes, size_t len, uint64_t base, vector<PbLogRecord>& records) {
+    size_t start = 0;
+    while (start < len) {
+        const char* eol = static_cast<const char*>(memchr(bytes + start, '\n', len - start));
+        if (eol == NULL) {
+            break;  // An incomplete line: its writer isn't done yet
+        }
+        size_t length = eol - (bytes + start);
+        string name = pb_line_name(bytes + start, length);
+        if (!name.empty()) {
+            PbLogRecord record;
+            record.line_offset = base + start;
+            record.line_length = (uint32_t)length;
+            record.hash = pb_hash_name(name);
+            records.push_back(record);
+        }
+        start += length + 1;
+    }
+    return start;
+}
+
+bool pb_log_append(int log_fd, const vector<PbLogRecord>& records) {
+    const char* bytes = reinterpret_cast<const char*>(records.data());
+    size_t left = records.size() * sizeof(PbLogRecord);
+    while (left > 0) {
+        ssize_t written = write(log_fd, bytes, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        left -= written;
+    }
+    return true;
+}
+
+// Writes all of data[0, len) to fd
+static bool write_all(int fd, const void* data, size_t len) {
+    const char* bytes = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t written = write(fd, bytes, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        len -= written;
+    }
+    return true;
+}
+
+// Reads all of [offset, offset + len) of fd into data
+static bool read_all(int fd, void* data, size_t len, uint64_t offset) {
+    char* bytes = static_cast<char*>(data);
+    while (len > 0) {
+        ssize_t got = pread(fd, bytes, len, (off_t)offset);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += got;
+        len -= got;
+        offset += got;
+    }
+    return true;
+}
+
+bool pb_sample_phonebook(int fd, uint64_t bytes, uint64_t& sample) {
+    uint64_t hash = 14695981039346656037ull;
+    if (bytes > 0) {
+        char block[PB_SAMPLE_BYTES];
+        size_t len = (size_t)min<uint64_t>(bytes, PB_SAMPLE_BYTES);
+        for (int k = 0; k < PB_SAMPLE_BLOCKS; ++k) {
+            uint64_t offset = (bytes - len) * k / (PB_SAMPLE_BLOCKS - 1);
+            if (!read_all(fd, block, len, offset)) {
+                return false;
+            }
+            for (size_t i = 0; i < len; ++i) {
+                hash = (hash ^ (unsigned char)block[i]) * 1099511628211ull;
+            }
+        }
+        if (block[len - 1] != '\n') {
+            return false;
+        }
+    }
+    sample = hash;
+    return true;
+}
+
+// Compares the name at name[0, len) with key, like string::compare
+static int compare_name(const char* name, size_t len, const string& key) {
+    int c = memcmp(name, key.data(), min(len, key.size()));
+    if (c != 0) {
+        return c;
+    }
+    return len < key.size() ? -1 : (len > key.size() ? 1 : 0);
+}
+
+// Holds the flock on the phonebook for the lifetime of the object
+class PhonebookLock {
+public:
+    explicit PhonebookLock(int fd) : fd_(fd) { flock(fd_, LOCK_EX); }
+    ~PhonebookLock() { flock(fd_, LOCK_UN); }
+private:
+    int fd_;
+};
+
+PhonebookIndex::PhonebookIndex()
+    : phonebook_fd_(-1), log_fd_(-1), phonebook_device_(0), phonebook_inode_(0), map_(NULL), map_size_(0), header_(NULL),
+      entries_(NULL), buckets_(NULL), sorted_(NULL), names_(NULL), lines_map_(NULL), lines_map_size_(0),
+      covered_(0), log_bytes_(0) {
+    checked_mtime_.tv_sec = 0;
+    checked_mtime_.tv_nsec = 0;
+}
+
+PhonebookIndex::~PhonebookIndex() {
+    unmap_snapshot();
+    if (lines_map_ != NULL) {
+        munmap(const_cast<char*>(lines_map_), lines_map_size_);
+    }
+    if (phonebook_fd_ >= 0) {
+        close(phonebook_fd_);
+    }
+    if (log_fd_ >= 0) {
+        close(log_fd_);
+    }
+}
+
+bool PhonebookIndex::open(const string& path, bool rebuild, string& error) {
+    path_ = path;
+    phonebook_fd_ = ::open(path.c_str(), O_RDONLY | O_CREAT, 0644);
+    log_fd_ = ::open((path + ".idx.log").c_str(), O_RDWR | O_APPEND | O_CREAT, 0644);
+    struct stat st;
+    if (phonebook_fd_ < 0 || log_fd_ < 0 || fstat(phonebook_fd_, &st) < 0) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    phonebook_device_ = (uint64_t)st.st_dev;
+    phonebook_inode_ = (uint64_t)st.st_ino;
+    checked_mtime_ = st.st_mtim;  // Before the checks below, so a write during them is seen later
+
+    {
+        PhonebookLock lock(phonebook_fd_);
+        error.clear();
+        bool valid = !rebuild && map_snapshot(error);
+        if (!error.empty()) {
+            return false;
+        }
+        struct stat log_st;
+        if (valid && fstat(log_fd_, &log_st) == 0) {
+            // Compact: a log longer than the snapshot makes startup slow
+            uint64_t logged = (uint64_t)log_st.st_size / sizeof(PbLogRecord);
+            valid = logged <= 1024 || logged <= header_->entries;
+        }
+        if (!valid && !build(error)) {
+            return false;
+        }
+        covered_ = header_->phonebook_bytes;
+        log_bytes_ = 0;
+        delta_.clear();
+    }
+    return refresh(error);
+}
+
+bool PhonebookIndex::map_snapshot(string& error) {
+    unmap_snapshot();
+    int fd = ::open((path_ + ".idx").c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            error = path_ + ".idx: " + strerror(errno);
+        }
+        return false;
+    }
+    struct stat st, phonebook_st;
+    bool ok = fstat(fd, &st) == 0 && fstat(phonebook_fd_, &phonebook_st) == 0 &&
+              (size_t)st.st_size >= sizeof(PbIndexHeader);
+    void* map = ok ? mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    map_ = static_cast<const char*>(map);
+    map_size_ = (size_t)st.st_size;
+
+    // Anything inconsistent means the snapshot is stale or damaged: rebuild it
+    const PbIndexHeader* h = reinterpret_cast<const PbIndexHeader*>(map_);
+    uint64_t size = map_size_;
+    bool valid = memcmp(h->magic, PB_INDEX_MAGIC, sizeof(PB_INDEX_MAGIC)) == 0 &&
+                 h->phonebook_device == (uint64_t)phonebook_st.st_dev &&
+                 h->phonebook_inode == (uint64_t)phonebook_st.st_ino &&
+                 h->phonebook_bytes <= (uint64_t)phonebook_st.st_size &&
+                 h->buckets > 0 && (h->buckets & (h->buckets - 1)) == 0 &&
+                 h->entries_offset + h->entries * sizeof(PbIndexEntry) <= size &&
+                 h->buckets_offset + h->buckets * sizeof(uint32_t) <= size &&
+                 h->sorted_offset + h->entries * sizeof(uint32_t) <= size &&
+                 h->names_offset + h->names_bytes <= size;
+    // Same file, but possibly rewritten in place since
+    uint64_t sample;
+    valid = valid && pb_sample_phonebook(phonebook_fd_, h->phonebook_bytes, sample) &&
+            sample == h->phonebook_sample;
+    if (!valid) {
+        unmap_snapshot();
+        return false;
+    }
+    header_ = h;
+    entries_ = reinterpret_cast<const PbIndexEntry*>(map_ + h->entries_offset);
+    buckets_ = reinterpret_cast<const uint32_t*>(map_ + h->buckets_offset);
+    sorted_ = reinterpret_cast<const uint32_t*>(map_ + h->sorted_offset);
+    names_ = map_ + h->names_offset;
+    return true;
+}
+
+void PhonebookIndex::unmap_snapshot() {
+    if (map_ != NULL) {
+        munmap(const_cast<char*>(map_), map_size_);
+    }
+    map_ = NULL;
+    map_size_ = 0;
+    header_ = NULL;
+}
+
+bool PhonebookIndex::build(string& error) {
+    // Index every complete line of the phonebook as it is now
+    struct stat st;
+    if (fstat(phonebook_fd_, &st) < 0) {
+        error = path_ + ": " + strerror(errno);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    vector<PbLogRecord> records;
+    vector<string> names;
+    uint64_t covered = 0;
+    if (size > 0) {
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, phonebook_fd_, 0);
+        if (map == MAP_FAILED) {
+            error = path_ + ": " + strerror(errno);
+            return false;
+        }
+        const char* bytes = static_cast<const char*>(map);
+        covered = pb_scan_lines(bytes, size, 0, records);
+        names.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            names.push_back(pb_line_name(bytes + records[i].line_offset, records[i].line_length));
+        }
+        munmap(map, size);
+    }
+
+    PbIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PB_INDEX_MAGIC, sizeof(PB_INDEX_MAGIC));
+    header.phonebook_bytes = covered;
+    header.phonebook_device = (uint64_t)st.st_dev;
+    header.phonebook_inode = (uint64_t)st.st_ino;
+    if (!pb_sample_phonebook(phonebook_fd_, covered, header.phonebook_sample)) {
+        error = path_ + ": changed while it was indexed";
+        return false;
+    }
+    header.entries = records.size();
+    header.buckets = 16;
+    while (header.buckets < 2 * header.entries) {
+        header.buckets *= 2;
+    }
+
+    vector<PbIndexEntry> entries(records.size());
+    vector<uint32_t> buckets(header.buckets, PB_NO_ENTRY);
+    string pool;
+    // Chains are built from the end, so every chain is in phonebook order
+    for (size_t i = records.size(); i-- > 0;) {
+        PbIndexEntry& e = entries[i];
+        e.line_offset = records[i].line_offset;
+        e.line_length = records[i].line_length;
+        e.hash = records[i].hash;
+        uint32_t& head = buckets[e.hash & (header.buckets - 1)];
+        e.next = head;
+        head = (uint32_t)i;
+    }
+    for (size_t i = 0; i < records.size(); ++i) {
+        entries[i].name_offset = pool.size();
+        entries[i].name_length = (uint32_t)names[i].size();
+        pool += names[i];
+    }
+    vector<uint32_t> sorted(records.size());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        sorted[i] = (uint32_t)i;
+    }
+    stable_sort(sorted.begin(), sorted.end(), [&names](uint32_t a, uint32_t b) { return names[a] < names[b]; });
+
+    header.entries_offset = sizeof(PbIndexHeader);
+    header.buckets_offset = header.entries_offset + entries.size() * sizeof(PbIndexEntry);
+    header.sorted_offset = header.buckets_offset + buckets.size() * sizeof(uint32_t);
+    header.names_offset = header.sorted_offset + sorted.size() * sizeof(uint32_t);
+    header.names_bytes = pool.size();
+
+    // Written aside and renamed over the old snapshot, so a reader only ever
+    // maps a complete one
+    string tmp = path_ + ".idx.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, entries.data(), entries.size() * sizeof(PbIndexEntry)) &&
+              write_all(fd, buckets.data(), buckets.size() * sizeof(uint32_t)) &&
+              write_all(fd, sorted.data(), sorted.size() * sizeof(uint32_t)) &&
+              write_all(fd, pool.data(), pool.size());
+    if (fd >= 0 && close(fd) < 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp.c_str(), (path_ + ".idx").c_str()) < 0 || ftruncate(log_fd_, 0) < 0) {
+        error = path_ + ".idx: " + strerror(errno);
+        unlink(tmp.c_str());
+        return false;
+    }
+    return map_snapshot(error);
+}
+
+void PhonebookIndex::add_delta(const PbLogRecord& record, const string& name) {
+    Line line;
+    line.offset = record.line_offset;
+    line.length = record.line_length;
+    delta_.insert(make_pair(name, line));
+    covered_ = record.line_offset + record.line_length + 1;
+}
+
+string PhonebookIndex::read_line(uint64_t offset, uint32_t length) const {
+    string line(length, '\0');
+    if (length > 0 && !read_all(phonebook_fd_, &line[0], length, offset)) {
+        line.clear();
+    }
+    return line;
+}
+
+bool PhonebookIndex::refresh(string& error) {
+    // The open descriptor keeps the old file alive, so a phonebook renamed
+    // over it only shows through its path
+    struct stat path_st, st, log_st;
+    if (stat(path_.c_str(), &path_st) < 0) {
+        error = path_ + ": " + strerror(errno) + ", the index must be rebuilt";
+        return false;
+    }
+    if (fstat(phonebook_fd_, &st) < 0 || fstat(log_fd_, &log_st) < 0) {
+        error = path_ + ": " + strerror(errno);
+        return false;
+    }
+    if ((uint64_t)path_st.st_dev != phonebook_device_ || (uint64_t)path_st.st_ino != phonebook_inode_ ||
+        (uint64_t)st.st_size < covered_) {
+        error = path_ + ": shrank or was replaced, the index must be rebuilt";
+        return false;
+    }
+    if (st.st_mtim.tv_sec != checked_mtime_.tv_sec || st.st_mtim.tv_nsec != checked_mtime_.tv_nsec) {
+        // Written to since the last check: appending leaves what is indexed
+        // as it was, rewriting in place almost never does
+        checked_mtime_ = st.st_mtim;
+        uint64_t sample;
+        char last = '\n';
+        bool same = pb_sample_phonebook(phonebook_fd_, header_->phonebook_bytes, sample) &&
+                    sample == header_->phonebook_sample &&
+                    (covered_ == 0 || read_all(phonebook_fd_, &last, 1, covered_ - 1)) && last == '\n';
+        if (!same) {
+            error = path_ + ": was rewritten, the index must be rebuilt";
+            return false;
+        }
+    }
+    if ((uint64_t)st.st_size == covered_ && (uint64_t)log_st.st_size == log_bytes_) {
+        map_lines();
+        return true;
+    }
+
+    PhonebookLock lock(phonebook_fd_);
+
+    // Records logged by writers; skip what is known already
+    if (fstat(log_fd_, &log_st) == 0 && (uint64_t)log_st.st_size > log_bytes_) {
+        size_t count = ((uint64_t)log_st.st_size - log_bytes_) / sizeof(PbLogRecord);
+        vector<PbLogRecord> records(count);
+        if (count > 0 && read_all(log_fd_, records.data(), count * sizeof(PbLogRecord), log_bytes_)) {
+            for (size_t i = 0; i < count; ++i) {
+                if (records[i].line_offset >= covered_) {
+                    // Unlogged lines before it, e.g. a last line that had no
+                    // newline until this writer added one
+                    scan_phonebook(records[i].line_offset, false);
+                    string line = read_line(records[i].line_offset, records[i].line_length);
+                    add_delta(records[i], pb_line_name(line.data(), line.size()));
+                }
+            }
+            log_bytes_ += count * sizeof(PbLogRecord);
+        }
+    }
+
+    // Lines nobody logged: scan them and log them, so a restart needn't
+    if (fstat(phonebook_fd_, &st) == 0) {
+        scan_phonebook((uint64_t)st.st_size, true);
+    }
+    map_lines();
+    return true;
+}
+
+void PhonebookIndex::map_lines() {
+    if ((uint64_t)lines_map_size_ == covered_) {
+        return;
+    }
+    if (lines_map_ != NULL) {
+        munmap(const_cast<char*>(lines_map_), lines_map_size_);
+    }
+    lines_map_ = NULL;
+    lines_map_size_ = 0;
+    // Writers append past the mapped bytes; a rewrite is caught by refresh()
+    void* map = mmap(NULL, (size_t)covered_, PROT_READ, MAP_SHARED, phonebook_fd_, 0);
+    if (map != MAP_FAILED) {
+        lines_map_ = static_cast<const char*>(map);
+        lines_map_size_ = (size_t)covered_;
+    }
+}
+
+void PhonebookIndex::scan_phonebook(uint64_t end, bool log) {
+    vector<char> buffer(1 << 20);
+    while (end > covered_) {
+        size_t want = (size_t)min<uint64_t>(buffer.size(), end - covered_);
+        if (!read_all(phonebook_fd_, buffer.data(), want, covered_)) {
+            break;
+        }
+        vector<PbLogRecord> records;
+        uint64_t base = covered_;
+        size_t consumed = pb_scan_lines(buffer.data(), want, base, records);
+        if (consumed == 0) {
+            if (want < buffer.size()) {
+                break;  // The last line is incomplete
+            }
+            buffer.resize(2 * buffer.size());  // A line longer than the buffer
+            continue;
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            const char* line = buffer.data() + (records[i].line_offset - base);
+            add_delta(records[i], pb_line_name(line, records[i].line_length));
+        }
+        covered_ = base + consumed;  // Also past lines without a name
+        if (log && pb_log_append(log_fd_, records)) {
+            log_bytes_ += records.size() * sizeof(PbLogRecord);
+        }
+    }
+}
+
+void PhonebookIndex::lookup(const string& name, bool prefix, vector<string>& phones) const {
+    string key = pb_normalize_name(name.data(), name.size());
+    vector<Line> lines;
+
+    if (header_ != NULL && !prefix) {
+        uint32_t hash = pb_hash_name(key);
+        for (uint32_t i = buckets_[hash & (header_->buckets - 1)]; i != PB_NO_ENTRY; i = entries_[i].next) {
+            const PbIndexEntry& e = entries_[i];
+            if (e.hash == hash && e.name_length == key.size() && memcmp(names_ + e.name_offset, key.data(), key.size()) == 0) {
+                Line line = {e.line_offset, e.line_length};
+                lines.push_back(line);
+            }
+        }
+    } else if (header_ != NULL) {
+        // First entry whose name is not less than the key, then every one it prefixes
+        const PbIndexEntry* entries = entries_;
+        const char* names = names_;
+        const uint32_t* first = lower_bound(sorted_, sorted_ + header_->entries, key,
+            [entries, names](uint32_t i, const string& k) {
+                return compare_name(names + entries[i].name_offset, entries[i].name_length, k) < 0;
+            });
+        for (const uint32_t* it = first; it != sorted_ + header_->entries; ++it) {
+            const PbIndexEntry& e = entries_[*it];
+            if (e.name_length < key.size() || memcmp(names_ + e.name_offset, key.data(), key.size()) != 0) {
+                break;
+            }
+            Line line = {e.line_offset, e.line_length};
+            lines.push_back(line);
+        }
+    }
+
+    typedef multimap<string, Line>::const_iterator delta_iterator;
+    if (!prefix) {
+        pair<delta_iterator, delta_iterator> range = delta_.equal_range(key);
+        for (delta_iterator it = range.first; it != range.second; ++it) {
+            lines.push_back(it->second);
+        }
+    } else {
+        for (delta_iterator it = delta_.lower_bound(key); it != delta_.end() && it->first.compare(0, key.size(), key) == 0; ++it) {
+            lines.push_back(it->second);
+        }
+    }
+
+    sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.offset < b.offset; });
+    phones.reserve(phones.size() + lines.size());
+    string text;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        // One pread per line only if the phonebook couldn't be mapped
+        const char* line;
+        size_t length = lines[i].length;
+        if (lines_map_ != NULL && lines[i].offset + length <= lines_map_size_) {
+            line = lines_map_ + lines[i].offset;
+        } else {
+            text = read_line(lines[i].offset, lines[i].length);
+            line = text.data();
+            length = text.size();
+        }
+        string phone;
+        pb_append_phone(line, length, phone);
+        phone.resize(phone.size() - 1);  // The newline
+        phones.push_back(phone);
+    }
+}
+
+size_t PhonebookIndex::size() const {
+    return (header_ != NULL ? (size_t)header_->entries : 0) + delta_.size();
+}
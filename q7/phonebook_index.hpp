@@ -0,0 +1,229 @@
+/**
+ * @file phonebook_index.hpp
+ * @brief Persistent index of phonebook.txt, used by phonebookd, findPhone and PB2add
+ *
+ * @details Two files next to the phonebook, named after its path:
+ *          - path + ".idx": a snapshot of the first phonebook_bytes bytes of
+ *            the phonebook, read with mmap(2) as it is on disk
+ *          - path + ".idx.log": one PbLogRecord per line appended after the
+ *            snapshot, in file order
+ *
+ *          The snapshot holds one PbIndexEntry per line, a hash table on the
+ *          normalized name (chained through PbIndexEntry::next), the entries
+ *          sorted by normalized name (for prefix lookups) and the normalized
+ *          names themselves. The phone numbers stay in phonebook.txt; every
+ *          entry has the offset of its line.
+ *
+ *          Writers append to phonebook.txt and to the log while holding an
+ *          flock(2) on phonebook.txt. Lines appended by a writer that doesn't
+ *          know about the index (e.g. a single PB2add) are found by
+ *          PhonebookIndex::refresh(), which logs them itself, so the snapshot
+ *          is only rebuilt when the log grows larger than it.
+ *
+ * @note A line is "Full Name,Phone-Number": its name is the text before the
+ *       first comma (all of it if there is none), normalized by
+ *       pb_normalize_name().
+ */
+#ifndef PHONEBOOK_INDEX_HPP
+#define PHONEBOOK_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+const char PB_INDEX_MAGIC[8] = {'P', 'B', 'I', 'D', 'X', 0, 0, 2};
+
+// The sample of pb_sample_phonebook(): PB_SAMPLE_BLOCKS blocks of
+// PB_SAMPLE_BYTES spread over the indexed bytes
+const int PB_SAMPLE_BLOCKS = 64;
+const int PB_SAMPLE_BYTES = 64;
+
+struct PbIndexHeader {
+    char magic[8];
+    uint64_t phonebook_bytes;  // the snapshot covers phonebook.txt[0, phonebook_bytes)
+    uint64_t phonebook_device; // a phonebook replaced by another file invalidates the index
+    uint64_t phonebook_inode;
+    uint64_t phonebook_sample; // pb_sample_phonebook() of phonebook.txt[0, phonebook_bytes)
+    uint64_t entries;
+    uint64_t buckets;          // power of two
+    uint64_t entries_offset;   // PbIndexEntry[entries]
+    uint64_t buckets_offset;   // uint32_t[buckets]: first entry of the chain, PB_NO_ENTRY if none
+    uint64_t sorted_offset;    // uint32_t[entries]: entry numbers by (name, line_offset)
+    uint64_t names_offset;     // the normalized names, back to back
+    uint64_t names_bytes;
+};
+
+struct PbIndexEntry {
+    uint64_t line_offset;
+    uint64_t name_offset;      // in the names section
+    uint32_t line_length;      // without the newline
+    uint32_t name_length;
+    uint32_t hash;             // pb_hash_name() of the normalized name
+    uint32_t next;             // next entry of the same bucket, PB_NO_ENTRY if none
+};
+
+struct PbLogRecord {
+    uint64_t line_offset;
+    uint32_t line_length;
+    uint32_t hash;
+};
+
+const uint32_t PB_NO_ENTRY = 0xffffffffu;
+
+/**
+ * Unix socket of phonebookd, in its working directory. A client
+ * sends lines "exact <name>\n" or "prefix <name>\n", and gets for each
+ * "<count>\n" followed by count phone lines, as findPhone prints them.
+ */
+const char PB_SOCKET_NAME[] = "phonebook.sock";
+
+/**
+ * @brief The name of a line as the index compares it: lowercase, with
+ *        leading/trailing blanks dropped and inner runs of blanks as one space
+ */
+std::string pb_normalize_name(const char* name, size_t len);
+
+// 32-bit FNV-1a of a normalized name
+uint32_t pb_hash_name(const std::string& normalized);
+
+// The normalized name of a phonebook line (the text before the first comma)
+std::string pb_line_name(const char* line, size_t len);
+
+/**
+ * @brief Appends what findPhone's grep | sed | sed | awk pipeline prints for
+ *        one matching line, newline included
+ *
+ * @details After sed 's/ /#/g' no space is left, and sed 's/,/ /' turns the
+ *          first comma into one; awk '{print $2}' then prints the second run
+ *          of non-blank characters (blanks being spaces and tabs). So the
+ *          result is the text after the first comma, up to the next tab,
+ *          with its spaces turned into '#' (and the field rules of awk for
+ *          lines without a comma or starting with one).
+ */
+void pb_append_phone(const char* line, size_t len, std::string& out);
+
+/**
+ * @brief Appends the log records of the complete lines in bytes[0, len),
+ *        which start at offset base of the phonebook
+ *
+ * @return The number of bytes consumed: up to and including the last newline
+ */
+size_t pb_scan_lines(const char* bytes, size_t len, uint64_t base, std::vector<PbLogRecord>& records);
+
+/**
+ * @brief Fingerprint of phonebook[0, bytes): FNV-1a of PB_SAMPLE_BLOCKS
+ *        blocks read at even intervals, the first at 0 and the last ending
+ *        at bytes
+ *
+ * @details A few KiB of reads however large the phonebook, so it can be
+ *          checked whenever the file changes; rewriting the indexed part in
+ *          place changes it unless every sampled block stays the same.
+ * @return false if the blocks can't be read, or bytes > 0 and the last of
+ *         them doesn't end with a newline (the snapshot only covers whole
+ *         lines)
+ */
+bool pb_sample_phonebook(int fd, uint64_t bytes, uint64_t& sample);
+
+/**
+ * @brief Appends records to the index log, path + ".idx.log" (fd opened with O_APPEND)
+ *
+ * @details The caller holds the flock on the phonebook, and has written the
+ *          lines the records point to.
+ * @return false if the write failed
+ */
+bool pb_log_append(int log_fd, const std::vector<PbLogRecord>& records);
+
+/**
+ * @brief The index as phonebookd uses it: the mapped snapshot plus the lines
+ *        after it (read from the log or from the phonebook itself)
+ */
+class PhonebookIndex {
+public:
+    PhonebookIndex();
+    ~PhonebookIndex();
+
+    /**
+     * @brief Opens (or creates) the index of the phonebook at path
+     *
+     * @details The index files are path + ".idx" and path + ".idx.log". The
+     *          snapshot is rebuilt if it is missing, rebuild is set, or it
+     *          belongs to other contents: another file, or a sample of the
+     *          bytes it covers (pb_sample_phonebook()) that no longer matches.
+     *          It is compacted at startup if the log has grown larger than it.
+     * @return false, with error set, if the files can't be read or written
+     */
+    bool open(const std::string& path, bool rebuild, std::string& error);
+
+    /**
+     * @brief Picks up lines appended to the phonebook since the last call
+     *
+     * @details Costs a stat(2) of the path and two fstat(2) calls when
+     *          nothing was appended. Otherwise the new log records are read,
+     *          and complete lines beyond them are scanned from the phonebook
+     *          and logged. Whenever the modification time moved, the sample
+     *          of the snapshot and the newline ending the indexed part are
+     *          checked again, to catch a phonebook rewritten in place.
+     * @return false, with error set, if the phonebook shrank, was replaced
+     *         or was rewritten (the index must then be reopened)
+     */
+    bool refresh(std::string& error);
+
+    /**
+     * @brief The phone numbers (as findPhone prints them, one per line) of
+     *        the lines whose normalized name equals, or with prefix set starts
+     *        with, the normalized name, in phonebook order
+     *
+     * @details The lines are read from a mapping of the indexed part of the
+     *          phonebook, which refresh() extends as lines are appended.
+     *          Truncating the phonebook between refresh() and lookup() would
+     *          fault on the mapping; writers only ever append to it.
+     */
+    void lookup(const std::string& name, bool prefix, std::vector<std::string>& phones) const;
+
+    // Lines indexed: snapshot plus delta
+    size_t size() const;
+
+private:
+    struct Line {
+        uint64_t offset;
+        uint32_t length;
+    };
+
+    bool build(std::string& error);
+    bool map_snapshot(std::string& error);
+    void unmap_snapshot();
+    // Maps phonebook[0, covered_) for lookup(), if it has grown since the last call
+    void map_lines();
+    void add_delta(const PbLogRecord& record, const std::string& name);
+    // Indexes the complete lines of phonebook[covered_, end), and logs them if log is set
+    void scan_phonebook(uint64_t end, bool log);
+    std::string read_line(uint64_t offset, uint32_t length) const;
+
+    std::string path_;
+    int phonebook_fd_;
+    int log_fd_;
+    uint64_t phonebook_device_;  // of the file open() opened at path_
+    uint64_t phonebook_inode_;
+
+    const char* map_;
+    size_t map_size_;
+    const PbIndexHeader* header_;
+    const PbIndexEntry* entries_;
+    const uint32_t* buckets_;
+    const uint32_t* sorted_;
+    const char* names_;
+
+    const char* lines_map_;   // phonebook[0, lines_map_size_), NULL if empty or not mappable
+    size_t lines_map_size_;
+
+    struct timespec checked_mtime_;  // of the phonebook when its contents were last checked
+    uint64_t covered_;       // phonebook bytes indexed, snapshot and delta
+    uint64_t log_bytes_;     // of the log read so far
+    std::multimap<std::string, Line> delta_;  // lines after the snapshot, by normalized name
+};
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * @file phonebookd.cpp
+ * @brief Lookup daemon for phonebook.txt (companion program to findPhone --query)
+ *
+ * @details Keeps the index of phonebook_index.hpp open and answers queries
+ *          on the Unix socket PB_SOCKET_NAME in the working directory:
+ *          - "exact <name>\n": lines whose normalized name is name
+ *          - "prefix <name>\n": lines whose normalized name starts with name
+ *          Each answer is "<count>\n" and count phone lines. A connection may
+ *          send any number of queries.
+ *
+ *          Before answering, the index picks up what was appended to the
+ *          phonebook since the last query (PhonebookIndex::refresh()), so new
+ *          entries are found without rebuilding. If the phonebook was replaced,
+ *          truncated or rewritten in place, the index is reopened, which
+ *          rebuilds it.
+ *
+ *          One thread serves all clients through poll(2); sockets are
+ *          non-blocking, so a slow client only delays itself. A client is
+ *          read from and answered only while its unsent answers are below
+ *          MAX_PENDING_OUTPUT, and gets at most MAX_REQUESTS_PER_WAKEUP
+ *          answers per turn, so one that floods requests without reading the
+ *          answers neither grows the daemon nor starves the others.
+ *
+ * @note Usage: ./phonebookd [--rebuild] [phonebook file]
+ *       SIGINT/SIGTERM stop the daemon and remove the socket.
+ */
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "phonebook_index.hpp"
+using namespace std;
+
+volatile sig_atomic_t stop_requested = 0;
+
+// Input read ahead for a client; an incomplete request longer than this
+// drops the client
+const size_t MAX_PENDING_INPUT = 64 * 1024;
+
+// Unsent answers at which a client is no longer read from or answered
+// until they are written (one answer may take it past this)
+const size_t MAX_PENDING_OUTPUT = 64 * 1024;
+
+// Requests answered for one client before the others get their turn
+const int MAX_REQUESTS_PER_WAKEUP = 16;
+
+void handle_stop(int) {
+    stop_requested = 1;
+}
+
+struct Client {
+    int fd;
+    string in;   // bytes received, up to an incomplete request
+    string out;  // answers not yet written
+    bool closed; // sent EOF: kept until out is written, then dropped
+};
+
+/**
+ * @brief Creates the listening socket, replacing a stale socket file left by
+ *        a daemon that didn't exit cleanly
+ *
+ * @return The socket, or -1 (with a message printed) on failure
+ */
+int listen_socket() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, PB_SOCKET_NAME, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("phonebookd: socket");
+        return -1;
+    }
+    int bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    if (bound < 0 && errno == EADDRINUSE) {
+        // Someone answering on it means another daemon is running
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool alive = probe >= 0 && connect(probe, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (alive) {
+            cerr << "phonebookd: already running on " << PB_SOCKET_NAME << "\n";
+            close(fd);
+            return -1;
+        }
+        unlink(PB_SOCKET_NAME);
+        bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    if (bound < 0) {
+        perror("phonebookd: bind");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, 64) < 0) {
+        perror("phonebookd: listen");
+        close(fd);
+        unlink(PB_SOCKET_NAME);
+        return -1;
+    }
+    return fd;
+}
+
+// Whether the client has a complete request and room for its answer
+bool can_answer(const Client& client) {
+    return client.out.size() < MAX_PENDING_OUTPUT && client.in.find('\n') != string::npos;
+}
+
+/**
+ * @brief Answers complete requests in client.in, up to MAX_REQUESTS_PER_WAKEUP
+ *        of them and until client.out reaches MAX_PENDING_OUTPUT
+ *
+ * @return false if a request is malformed (the client is then dropped)
+ */
+bool answer(Client& client, const PhonebookIndex& index) {
+    size_t start = 0;
+    size_t eol;
+    int answered = 0;
+    while (answered < MAX_REQUESTS_PER_WAKEUP && client.out.size() < MAX_PENDING_OUTPUT &&
+           (eol = client.in.find('\n', start)) != string::npos) {
+        ++answered;
+        string request = client.in.substr(start, eol - start);
+        start = eol + 1;
+
+        bool prefix;
+        string name;
+        if (request.compare(0, 6, "exact ") == 0) {
+            prefix = false;
+            name = request.substr(6);
+        } else if (request.compare(0, 7, "prefix ") == 0) {
+            prefix = true;
+            name = request.substr(7);
+        } else {
+            return false;
+        }
+
+        vector<string> phones;
+        index.lookup(name, prefix, phones);
+        client.out += to_string(phones.size()) + "\n";
+        for (size_t i = 0; i < phones.size(); ++i) {
+            client.out += phones[i];
+            client.out += '\n';
+        }
+    }
+    client.in.erase(0, start);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    bool rebuild = false;
+    string path = "phonebook.txt";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--rebuild") == 0) {
+            rebuild = true;
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            cerr << "Usage: ./phonebookd [--rebuild] [phonebook file]\n";
+            return 1;
+        }
+    }
+
+    string error;
+    unique_ptr<PhonebookIndex> index(new PhonebookIndex());
+    if (!index->open(path, rebuild, error)) {
+        cerr << "phonebookd: " << error << "\n";
+        return 1;
+    }
+
+    // No SA_RESTART: the signal interrupts poll(), so the loop ends
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);  // A client that hung up must not kill the daemon
+
+    int listen_fd = listen_socket();
+    if (listen_fd < 0) {
+        return 1;
+    }
+    cout << "phonebookd: " << index->size() << " entries, listening on " << PB_SOCKET_NAME << endl;
+
+    vector<Client> clients;
+    char buffer[65536];
+    while (!stop_requested) {
+        vector<struct pollfd> fds(1 + clients.size());
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        // Requests already read but not answered yet: don't wait for more
+        bool backlog = false;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            const Client& client = clients[i];
+            fds[1 + i].fd = client.fd;
+            // More input only once the answers so far are written
+            bool readable = !client.closed && client.out.empty() && client.in.size() <= MAX_PENDING_INPUT;
+            short events = readable ? POLLIN : 0;
+            fds[1 + i].events = client.out.empty() ? events : events | POLLOUT;
+            backlog = backlog || can_answer(client);
+        }
+        if (poll(fds.data(), fds.size(), backlog ? 0 : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("phonebookd: poll");
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                Client client;
+                client.fd = fd;
+                client.closed = false;
+                clients.push_back(client);
+            }
+        }
+
+        // One refresh per wakeup, however many requests it carries
+        bool refreshed = false;
+        vector<bool> drop(clients.size(), false);
+        for (size_t i = 0; i + 1 < fds.size(); ++i) {
+            Client& client = clients[i];
+            short revents = fds[1 + i].revents;
+            if ((fds[1 + i].events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR))) {
+                // Past the limit the rest stays in the socket until the
+                // requests read so far are answered
+                ssize_t got = 1;
+                while (client.in.size() <= MAX_PENDING_INPUT &&
+                       (got = read(client.fd, buffer, sizeof(buffer))) > 0) {
+                    client.in.append(buffer, got);
+                }
+                if (got < 0 && errno != EAGAIN && errno != EINTR) {
+                    drop[i] = true;
+                    continue;
+                }
+                if (got == 0) {
+                    client.closed = true;  // Hung up: answer what it sent, then drop it
+                }
+            } else if (revents & POLLERR) {
+                drop[i] = true;
+                continue;
+            }
+            if (can_answer(client)) {
+                if (!refreshed) {
+                    if (!index->refresh(error)) {
+                        cerr << "phonebookd: " << error << ", reopening\n";
+                        index.reset(new PhonebookIndex());
+                        if (!index->open(path, false, error)) {
+                            cerr << "phonebookd: " << error << "\n";
+                            stop_requested = 1;
+                            break;
+                        }
+                    }
+                    refreshed = true;
+                }
+                if (!answer(client, *index)) {
+                    drop[i] = true;
+                    continue;
+                }
+            }
+            if (client.in.size() > MAX_PENDING_INPUT && client.in.find('\n') == string::npos) {
+                cerr << "phonebookd: dropping a client whose request is over "
+                     << MAX_PENDING_INPUT << " bytes\n";
+                drop[i] = true;
+                continue;
+            }
+            while (!client.out.empty()) {
+                ssize_t written = write(client.fd, client.out.data(), client.out.size());
+                if (written < 0) {
+                    drop[i] = errno != EAGAIN && errno != EINTR;
+                    break;
+                }
+                client.out.erase(0, written);
+            }
+            if (client.closed && client.out.empty() && client.in.find('\n') == string::npos) {
+                drop[i] = true;
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (i < drop.size() && drop[i]) {
+                close(clients[i].fd);
+            } else {
+                clients[kept++] = clients[i];
+            }
+        }
+        clients.resize(kept);
+    }
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+        close(clients[i].fd);
+    }
+    close(listen_fd);
+    unlink(PB_SOCKET_NAME);
+    return 0;
+}